@@ -0,0 +1,23 @@
+
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stdint.h>
+
+#include "audio.h"
+
+// Only linked into builds with EMBED_ASSETS. assets.c is generated by
+// tools/embed-assets from invaders.rom and sounds/.
+
+// Signed 16-bit mono PCM at the rate of the original WAV
+typedef struct EmbeddedSound {
+    const int16_t *samples;
+    uint32_t length;
+    uint32_t rate;
+} EmbeddedSound;
+
+extern const uint8_t embedded_rom[];
+extern const uint32_t embedded_rom_size;
+extern const EmbeddedSound embedded_sounds[SOUND_COUNT];
+
+#endif
@@ -1,59 +1,78 @@
 
-#include <SDL_mixer.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SDL.h"
 
 #include "audio.h"
+#include "machine.h"
+#include "mixer.h"
+#include "timeline.h"
 
-Mix_Chunk *snd_shoot = NULL;
-Mix_Chunk *snd_explosion = NULL;
-Mix_Chunk *snd_invader_1 = NULL;
-Mix_Chunk *snd_invader_2 = NULL;
-Mix_Chunk *snd_invader_3 = NULL;
-Mix_Chunk *snd_invader_4 = NULL;
-Mix_Chunk *snd_invader_killed = NULL;
-Mix_Chunk *snd_ufo_high = NULL;
-Mix_Chunk *snd_ufo_low = NULL;
+// Samples per callback, 512 is under 12 ms at 44.1 kHz
+#define AUDIO_SAMPLE_RATE 44100
+#define AUDIO_BUFFER_SAMPLES 512
 
-void init_audio() {
-    snd_shoot = Mix_LoadWAV("sounds/shoot.wav");
-    snd_explosion = Mix_LoadWAV("sounds/explosion.wav");
-    snd_invader_1 = Mix_LoadWAV("sounds/fastinvader1.wav");
-    snd_invader_2 = Mix_LoadWAV("sounds/fastinvader2.wav");
-    snd_invader_3 = Mix_LoadWAV("sounds/fastinvader3.wav");
-    snd_invader_4 = Mix_LoadWAV("sounds/fastinvader4.wav");
-    snd_invader_killed = Mix_LoadWAV("sounds/invaderkilled.wav");
-    snd_ufo_high = Mix_LoadWAV("sounds/ufo_highpitch.wav");
-    snd_ufo_low = Mix_LoadWAV("sounds/ufo_lowpitch.wav");
+static SDL_AudioDeviceID audio_device = 0;
+static pthread_t loader_thread;
+
+static void fill_audio(void *userdata, Uint8 *stream, int len) {
+    (void)userdata;
+
+    name_timeline_thread("audio");
+    uint64_t start = begin_timeline_event();
+    mix_sounds((int16_t *)stream, len / sizeof(int16_t));
+    end_timeline_event("mix", start);
 }
 
+static void *load_sounds_in_background(void *arg) {
+    (void)arg;
 
-void play_sound(SoundType sound) {
-    switch (sound) {
-        case SOUND_SHOOT:
-            Mix_PlayChannel(-1, snd_shoot, 0);
-            break;
-        case SOUND_EXPLOSION:
-            Mix_PlayChannel(-1, snd_explosion, 0);
-            break;
-        case SOUND_INVADER_1:
-            Mix_PlayChannel(-1, snd_invader_1, 0);
-            break;
-        case SOUND_INVADER_2:
-            Mix_PlayChannel(-1, snd_invader_2, 0);
-            break;
-        case SOUND_INVADER_3:
-            Mix_PlayChannel(-1, snd_invader_3, 0);
-            break;
-        case SOUND_INVADER_4:
-            Mix_PlayChannel(-1, snd_invader_4, 0);
-            break;
-        case SOUND_INVADER_KILLED:
-            Mix_PlayChannel(-1, snd_invader_killed, 0);
-            break;
-        case SOUND_UFO_HIGH:
-            Mix_PlayChannel(-1, snd_ufo_high, 0);
-            break;
-        case SOUND_UFO_LOW:
-            Mix_PlayChannel(-1, snd_ufo_low, 0);
-            break;
+    name_timeline_thread("sound loader");
+    uint64_t start = begin_timeline_event();
+    if (!load_sounds()) {
+        exit(1);
     }
+    end_timeline_event("load_sounds", start);
+    return NULL;
+}
+
+// Sounds are decoded and resampled to whatever rate the device opened
+// with on a thread of their own, so the CPU can boot meanwhile. The
+// callback plays silence until they are ready.
+void init_audio() {
+    SDL_AudioSpec want;
+    SDL_AudioSpec have;
+
+    SDL_zero(want);
+    want.freq = AUDIO_SAMPLE_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = AUDIO_BUFFER_SAMPLES;
+    want.callback = fill_audio;
+
+    audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have,
+                                       SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (audio_device == 0) {
+        printf("Audio device could not open! SDL_Error: %s\n",
+               SDL_GetError());
+        exit(1);
+    }
+
+    init_mixer(have.freq, CLOCK_HZ);
+    if (pthread_create(&loader_thread, NULL, load_sounds_in_background,
+                       NULL) != 0) {
+        printf("Error starting sound loader thread\n");
+        exit(1);
+    }
+    pthread_detach(loader_thread);
+
+    SDL_PauseAudioDevice(audio_device, 0);
+}
+
+// Never blocks, the mixer plays the event SOUND_LATENCY_MS after the
+// emulated time it happened at
+void play_sound(SoundEvent event) {
+    queue_sound(event);
 }
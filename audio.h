@@ -2,6 +2,9 @@
 #ifndef AUDIO_H
 #define AUDIO_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 typedef enum SoundType {
     SOUND_SHOOT,
     SOUND_INVADER_1,
@@ -11,10 +14,19 @@ typedef enum SoundType {
     SOUND_INVADER_KILLED,
     SOUND_EXPLOSION,
     SOUND_UFO_HIGH,
-    SOUND_UFO_LOW
+    SOUND_UFO_LOW,
+    SOUND_COUNT
 } SoundType;
 
+// A sound port bit changing, stamped with the emulated cycle count
+typedef struct SoundEvent {
+    uint64_t cycle;
+    uint8_t sound;          // SoundType
+    // False when the bit clears, which only stops looping sounds
+    bool is_start;
+} SoundEvent;
+
 void init_audio(void);
-void play_sound(SoundType);
+void play_sound(SoundEvent);
 
 #endif
@@ -0,0 +1,367 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "cpu.h"
+#include "framebuffer.h"
+#include "machine.h"
+#include "opstats.h"
+#include "profile.h"
+#include "replay.h"
+#include "trace.h"
+
+#define DEFAULT_FRAME_COUNT 3600
+
+// Timing every instruction would cost more than the instructions
+// themselves, so the decode/execute/IO split is taken from one
+// instruction in SAMPLE_INTERVAL and scaled to the measured total
+#define SAMPLE_INTERVAL 64
+
+// XTHL, the slowest 8080 instruction. A slice runs until it reaches
+// CYCLES_PER_SLICE, so it can only overrun by less than this.
+#define MAX_INSTR_CYCLES 18
+
+typedef struct BenchResult {
+    // Guest instructions, a fused sequence counts as all of its own
+    uint64_t instr_count;
+    uint64_t fetch_count;
+    uint64_t cycle_count;
+    uint64_t total_ns;
+    uint64_t *frame_ns;
+    int frame_count;
+
+    // Sums over the sampled instructions only
+    uint64_t sampled_decode_ns;
+    uint64_t sampled_execute_ns;
+    uint64_t sampled_io_ns;
+
+    uint64_t render_ns;
+} BenchResult;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void run_slice(BenchResult *result) {
+    Instr instr;
+    int cycle_count = 0;
+
+    while (cycle_count < CYCLES_PER_SLICE) {
+        if (result->fetch_count++ % SAMPLE_INTERVAL == 0) {
+            uint64_t t0 = now_ns();
+            instr = fetch_fused_instr(CYCLES_PER_SLICE - cycle_count);
+            uint64_t t1 = now_ns();
+            cycle_count += exec_instr(instr);
+            uint64_t t2 = now_ns();
+            process_shift_register();
+            process_sound();
+            uint64_t t3 = now_ns();
+
+            result->sampled_decode_ns += t1 - t0;
+            result->sampled_execute_ns += t2 - t1;
+            result->sampled_io_ns += t3 - t2;
+        } else {
+            instr = fetch_fused_instr(CYCLES_PER_SLICE - cycle_count);
+            cycle_count += exec_instr(instr);
+            process_shift_register();
+            process_sound();
+        }
+        result->instr_count += get_guest_instr_count(instr);
+    }
+
+    result->cycle_count += cycle_count;
+}
+
+static void run_bench(BenchResult *result, InputScript *script) {
+    static uint32_t pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+    uint8_t *v_ram = &get_machine_memory()[0x2400];
+    uint64_t start = now_ns();
+
+    for (int frame = 0; frame < result->frame_count; frame++) {
+        uint64_t frame_start = now_ns();
+
+        apply_inputs(get_script_inputs(script, frame));
+
+        run_slice(result);
+        half_draw_interrupt();
+
+        run_slice(result);
+        uint64_t render_start = now_ns();
+        draw_frame(v_ram, pixels);
+        uint64_t render_end = now_ns();
+        full_draw_interrupt();
+
+        result->render_ns += render_end - render_start;
+        result->frame_ns[frame] = now_ns() - frame_start;
+
+        update_sound_capture(get_cycle_count());
+    }
+
+    result->total_ns = now_ns() - start;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Expects `sorted` to be in ascending order
+static uint64_t percentile(uint64_t *sorted, int count, double p) {
+    int index = (int)(p * count + 0.999999) - 1;
+    if (index < 0) {
+        index = 0;
+    }
+    if (index >= count) {
+        index = count - 1;
+    }
+    return sorted[index];
+}
+
+// Cycles per frame have to average out to the two slices, plus at most
+// one instruction's worth of overrun per slice
+static bool check_cycles_per_frame(BenchResult *result) {
+    double cycles_per_frame = (double)result->cycle_count /
+                              result->frame_count;
+
+    if (cycles_per_frame < 2 * CYCLES_PER_SLICE ||
+        cycles_per_frame >= 2 * (CYCLES_PER_SLICE + MAX_INSTR_CYCLES)) {
+        printf("Error: %.1f cycles/frame, expected %d to %d\n",
+               cycles_per_frame, 2 * CYCLES_PER_SLICE,
+               2 * (CYCLES_PER_SLICE + MAX_INSTR_CYCLES) - 1);
+        return false;
+    }
+    return true;
+}
+
+// Writes text as a quoted JSON string, paths can hold quotes and
+// backslashes
+static void write_json_string(FILE *fp, const char *text) {
+    fputc('"', fp);
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(fp, "\\%c", *c);
+        } else if ((unsigned char)*c < 0x20) {
+            fprintf(fp, "\\u%04x", (unsigned char)*c);
+        } else {
+            fputc(*c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void write_report(BenchResult *result, char *rom_path,
+                         char *script_name, char *out_path) {
+    uint64_t *sorted = malloc(result->frame_count * sizeof(uint64_t));
+    memcpy(sorted, result->frame_ns, result->frame_count * sizeof(uint64_t));
+    qsort(sorted, result->frame_count, sizeof(uint64_t), compare_u64);
+
+    uint64_t p50 = percentile(sorted, result->frame_count, 0.50);
+    uint64_t p99 = percentile(sorted, result->frame_count, 0.99);
+    uint64_t p999 = percentile(sorted, result->frame_count, 0.999);
+    uint64_t max = sorted[result->frame_count - 1];
+
+    double seconds = result->total_ns / 1e9;
+    double instr_per_sec = result->instr_count / seconds;
+    double emulated_mhz = result->cycle_count / seconds / 1e6;
+    double cycles_per_frame = (double)result->cycle_count /
+                              result->frame_count;
+
+    // Everything that isn't rendering is split in the sampled ratio
+    uint64_t cpu_ns = result->total_ns - result->render_ns;
+    uint64_t sampled_ns = result->sampled_decode_ns +
+                          result->sampled_execute_ns +
+                          result->sampled_io_ns;
+    uint64_t decode_ns = 0;
+    uint64_t execute_ns = 0;
+    uint64_t io_ns = 0;
+    if (sampled_ns > 0) {
+        decode_ns = cpu_ns * result->sampled_decode_ns / sampled_ns;
+        execute_ns = cpu_ns * result->sampled_execute_ns / sampled_ns;
+        io_ns = cpu_ns - decode_ns - execute_ns;
+    }
+
+    printf("frames:            %d\n", result->frame_count);
+    printf("instructions:      %llu\n",
+           (unsigned long long)result->instr_count);
+    printf("instructions/s:    %.0f\n", instr_per_sec);
+    printf("emulated MHz:      %.2f\n", emulated_mhz);
+    printf("cycles/frame:      %.1f (target %d)\n", cycles_per_frame,
+           2 * CYCLES_PER_SLICE);
+    printf("ns/frame p50:      %llu\n", (unsigned long long)p50);
+    printf("ns/frame p99:      %llu\n", (unsigned long long)p99);
+    printf("ns/frame p99.9:    %llu\n", (unsigned long long)p999);
+    printf("ns/frame max:      %llu\n", (unsigned long long)max);
+    printf("decode:            %5.1f%%\n", 100.0 * decode_ns / result->total_ns);
+    printf("execute:           %5.1f%%\n", 100.0 * execute_ns / result->total_ns);
+    printf("io:                %5.1f%%\n", 100.0 * io_ns / result->total_ns);
+    printf("render:            %5.1f%%\n",
+           100.0 * result->render_ns / result->total_ns);
+
+    FILE *fp = fopen(out_path, "w");
+    if (fp == NULL) {
+        printf("Error opening output file %s\n", out_path);
+        exit(1);
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"rom\": ");
+    write_json_string(fp, rom_path);
+    fprintf(fp, ",\n  \"input_script\": ");
+    write_json_string(fp, script_name);
+    fprintf(fp, ",\n");
+    fprintf(fp, "  \"frames\": %d,\n", result->frame_count);
+    fprintf(fp, "  \"instructions\": %llu,\n",
+            (unsigned long long)result->instr_count);
+    fprintf(fp, "  \"cycles\": %llu,\n",
+            (unsigned long long)result->cycle_count);
+    fprintf(fp, "  \"total_ns\": %llu,\n",
+            (unsigned long long)result->total_ns);
+    fprintf(fp, "  \"instructions_per_second\": %.0f,\n", instr_per_sec);
+    fprintf(fp, "  \"emulated_mhz\": %.4f,\n", emulated_mhz);
+    fprintf(fp, "  \"cycles_per_frame\": %.1f,\n", cycles_per_frame);
+    fprintf(fp, "  \"frame_ns\": {\"p50\": %llu, \"p99\": %llu, "
+                "\"p99_9\": %llu, \"max\": %llu},\n",
+            (unsigned long long)p50, (unsigned long long)p99,
+            (unsigned long long)p999, (unsigned long long)max);
+    fprintf(fp, "  \"phase_ns\": {\"decode\": %llu, \"execute\": %llu, "
+                "\"io\": %llu, \"render\": %llu},\n",
+            (unsigned long long)decode_ns, (unsigned long long)execute_ns,
+            (unsigned long long)io_ns,
+            (unsigned long long)result->render_ns);
+    fprintf(fp, "  \"sample_interval\": %d\n", SAMPLE_INTERVAL);
+    fprintf(fp, "}\n");
+
+    fclose(fp);
+    free(sorted);
+}
+
+static void print_usage(char *name) {
+    printf("Usage: %s [-f frames] [-i input_script] [-o output.json] "
+           "[-t trace_file] [-p profile_prefix] [-s symbol_file] "
+           "[-m opcode_stats] [-a audio.wav] [-e sound_events] [rom]\n",
+           name);
+}
+
+int main(int argc, char *argv[]) {
+    BenchResult result = {0};
+    InputScript script;
+    char *rom_path = "invaders.rom";
+    char *script_path = NULL;
+    char *out_path = "bench.json";
+    char *trace_path = NULL;
+    char *profile_prefix = NULL;
+    char *symbol_path = NULL;
+    char *stats_path = NULL;
+    char *wav_path = NULL;
+    char *sound_event_path = NULL;
+    int opt;
+
+    result.frame_count = DEFAULT_FRAME_COUNT;
+
+    while ((opt = getopt(argc, argv, "f:i:o:t:p:s:m:a:e:h")) != -1) {
+        switch (opt) {
+            case 'f':
+                result.frame_count = atoi(optarg);
+                break;
+            case 'i':
+                script_path = optarg;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 't':
+                trace_path = optarg;
+                break;
+            case 'p':
+                profile_prefix = optarg;
+                break;
+            case 's':
+                symbol_path = optarg;
+                break;
+            case 'm':
+                stats_path = optarg;
+                break;
+            case 'a':
+                wav_path = optarg;
+                break;
+            case 'e':
+                sound_event_path = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    if (optind < argc) {
+        rom_path = argv[optind];
+    }
+    if (result.frame_count <= 0) {
+        print_usage(argv[0]);
+        exit(1);
+    }
+
+#ifndef CPU_PROFILE
+    if (profile_prefix != NULL) {
+        printf("Profiling needs a build with -DCPU_PROFILE\n");
+        exit(1);
+    }
+#endif
+#ifndef CPU_OPCODE_STATS
+    if (stats_path != NULL) {
+        printf("Opcode statistics need a build with -DCPU_OPCODE_STATS\n");
+        exit(1);
+    }
+#endif
+    if (symbol_path != NULL && !load_profile_symbols(symbol_path)) {
+        exit(1);
+    }
+
+    if (script_path == NULL) {
+        load_builtin_input_script(&script);
+    } else if (!load_input_script(&script, script_path)) {
+        exit(1);
+    }
+
+    result.frame_ns = malloc(result.frame_count * sizeof(uint64_t));
+
+    init_machine(rom_path);
+
+    if (wav_path != NULL || sound_event_path != NULL) {
+        if (!start_sound_capture(wav_path, sound_event_path)) {
+            exit(1);
+        }
+        set_sound_handler(capture_sound_event);
+    }
+
+    // The trace is kept complete, so it slows the run down
+    if (trace_path != NULL && !start_trace(trace_path, true)) {
+        exit(1);
+    }
+
+    run_bench(&result, &script);
+    stop_trace();
+    stop_sound_capture(get_cycle_count());
+    if (profile_prefix != NULL && !write_profile(profile_prefix)) {
+        exit(1);
+    }
+    if (stats_path != NULL && !save_opcode_stats(stats_path)) {
+        exit(1);
+    }
+    write_report(&result, rom_path,
+                 script_path == NULL ? "builtin" : script_path, out_path);
+
+    bool is_timing_ok = check_cycles_per_frame(&result);
+
+    free(result.frame_ns);
+    free_input_script(&script);
+    return is_timing_ok ? 0 : 1;
+}
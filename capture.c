@@ -0,0 +1,142 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "capture.h"
+#include "machine.h"
+#include "mixer.h"
+
+#define WAV_HEADER_SIZE 44
+#define RENDER_CHUNK_SAMPLES 1024
+
+static char *sound_names[SOUND_COUNT] = {
+    [SOUND_SHOOT] = "shoot",
+    [SOUND_INVADER_1] = "invader_1",
+    [SOUND_INVADER_2] = "invader_2",
+    [SOUND_INVADER_3] = "invader_3",
+    [SOUND_INVADER_4] = "invader_4",
+    [SOUND_INVADER_KILLED] = "invader_killed",
+    [SOUND_EXPLOSION] = "explosion",
+    [SOUND_UFO_HIGH] = "ufo_high",
+    [SOUND_UFO_LOW] = "ufo_low"
+};
+
+static FILE *wav_file = NULL;
+static FILE *event_file = NULL;
+static uint64_t rendered_samples = 0;
+
+static void write_le32(uint8_t *bytes, uint32_t val) {
+    bytes[0] = val;
+    bytes[1] = val >> 8;
+    bytes[2] = val >> 16;
+    bytes[3] = val >> 24;
+}
+
+static void write_le16(uint8_t *bytes, uint16_t val) {
+    bytes[0] = val;
+    bytes[1] = val >> 8;
+}
+
+// 16-bit mono PCM, rewritten with the real sizes when capture stops
+static void write_wav_header(uint32_t sample_count) {
+    uint8_t header[WAV_HEADER_SIZE];
+    uint32_t data_size = sample_count * sizeof(int16_t);
+
+    memcpy(header, "RIFF", 4);
+    write_le32(header + 4, WAV_HEADER_SIZE - 8 + data_size);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    write_le32(header + 16, 16);
+    write_le16(header + 20, 1);
+    write_le16(header + 22, 1);
+    write_le32(header + 24, CAPTURE_SAMPLE_RATE);
+    write_le32(header + 28, CAPTURE_SAMPLE_RATE * sizeof(int16_t));
+    write_le16(header + 32, sizeof(int16_t));
+    write_le16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    write_le32(header + 40, data_size);
+
+    fseek(wav_file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof header, wav_file);
+}
+
+// Renders the game's sounds into the WAV at `wav_path` and/or lists
+// the sound events in `event_path`, either may be NULL. Nothing needs
+// an audio device: the mixer runs in step with emulation, so the
+// capture is as fast as the emulator and sample n of the WAV is
+// emulated time n / CAPTURE_SAMPLE_RATE.
+bool start_sound_capture(char *wav_path, char *event_path) {
+    if (wav_path != NULL) {
+        init_mixer(CAPTURE_SAMPLE_RATE, CLOCK_HZ);
+        lock_mixer_to_cycles();
+        if (!load_sounds()) {
+            return false;
+        }
+
+        wav_file = fopen(wav_path, "wb");
+        if (wav_file == NULL) {
+            printf("Error opening WAV file %s\n", wav_path);
+            return false;
+        }
+        write_wav_header(0);
+        rendered_samples = 0;
+    }
+
+    if (event_path != NULL) {
+        event_file = fopen(event_path, "w");
+        if (event_file == NULL) {
+            printf("Error opening sound event file %s\n", event_path);
+            return false;
+        }
+        fprintf(event_file, "%s\n", SOUND_EVENT_FILE_HEADER);
+    }
+
+    return true;
+}
+
+// Sound handler for set_sound_handler
+void capture_sound_event(SoundEvent event) {
+    if (event_file != NULL) {
+        fprintf(event_file, "%llu %s %s\n", (unsigned long long)event.cycle,
+                sound_names[event.sound], event.is_start ? "start" : "stop");
+    }
+    if (wav_file != NULL) {
+        queue_sound(event);
+    }
+}
+
+// Mixes everything up to emulated cycle `cycle`. Has to be called at
+// least every few frames so the mixer's event queue doesn't fill up.
+void update_sound_capture(uint64_t cycle) {
+    static int16_t samples[RENDER_CHUNK_SAMPLES];
+    uint64_t target = cycle * CAPTURE_SAMPLE_RATE / CLOCK_HZ;
+
+    if (wav_file == NULL) {
+        return;
+    }
+
+    while (rendered_samples < target) {
+        int count = RENDER_CHUNK_SAMPLES;
+        if (target - rendered_samples < RENDER_CHUNK_SAMPLES) {
+            count = target - rendered_samples;
+        }
+        mix_sounds(samples, count);
+        fwrite(samples, sizeof(int16_t), count, wav_file);
+        rendered_samples += count;
+    }
+}
+
+// Renders up to `cycle` and closes the files
+void stop_sound_capture(uint64_t cycle) {
+    if (wav_file != NULL) {
+        update_sound_capture(cycle);
+        write_wav_header(rendered_samples);
+        fclose(wav_file);
+        wav_file = NULL;
+    }
+    if (event_file != NULL) {
+        fclose(event_file);
+        event_file = NULL;
+    }
+}
@@ -0,0 +1,19 @@
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio.h"
+
+#define CAPTURE_SAMPLE_RATE 44100
+
+#define SOUND_EVENT_FILE_HEADER "# space invaders sound events v1"
+
+bool start_sound_capture(char *, char *);
+void capture_sound_event(SoundEvent);
+void update_sound_capture(uint64_t);
+void stop_sound_capture(uint64_t);
+
+#endif
@@ -0,0 +1,417 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../cpu.h"
+#include "../disasm.h"
+
+// Each measurement runs BLOCK_COUNT blocks of BLOCK_LEN copies of the
+// same instruction, resetting the registers between blocks, and keeps
+// the fastest of REPEAT_COUNT measurements
+#define BLOCK_LEN 256
+#define BLOCK_COUNT 2000
+#define REPEAT_COUNT 5
+
+#define CODE_START 0x1000
+#define DATA_ADDR 0x8000
+#define STACK_TOP 0xc000
+#define IO_PORT 0x10
+
+// Rows slower than the baseline by more than this are flagged,
+// unless overridden with -t
+#define DEFAULT_REGRESSION_THRESHOLD 10.0
+
+typedef enum Variant {
+    VARIANT_NONE,
+    VARIANT_TAKEN,
+    VARIANT_NOT_TAKEN
+} Variant;
+
+typedef struct Result {
+    uint8_t opcode;
+    InstrType type;
+    char mnemonic[5];
+    Variant variant;
+    double ns;
+} Result;
+
+typedef struct Baseline {
+    uint8_t opcode;
+    Variant variant;
+    double ns;
+} Baseline;
+
+static uint8_t memory[65536];
+static CpuInnards cpu;
+
+static char *variant_names[] = { "", "taken", "not-taken" };
+
+static double regression_threshold = DEFAULT_REGRESSION_THRESHOLD;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static Instr decode_opcode(uint8_t opcode) {
+    memory[CODE_START] = opcode;
+    *(cpu.pc) = CODE_START;
+    flush_decode_cache();
+    return fetch_instr();
+}
+
+static bool is_branch_to_operand(InstrType type) {
+    return (type >= INSTR_CALL && type <= INSTR_CALL_IF_PARITY_ODD) ||
+           (type >= INSTR_JUMP && type <= INSTR_JUMP_IF_PARITY_ODD);
+}
+
+static bool is_restart(InstrType type) {
+    return type >= INSTR_RESTART_0 && type <= INSTR_RESTART_7;
+}
+
+// Returns the flag tested by a conditional branch, with *when_set
+// telling whether the branch is taken when the flag is set
+static bool *condition_flag(InstrType type, bool *when_set) {
+    switch (type) {
+        case INSTR_CALL_IF_CARRY:
+        case INSTR_JUMP_IF_CARRY:
+        case INSTR_RETURN_IF_CARRY:
+            *when_set = true;
+            return cpu.flag_carry;
+        case INSTR_CALL_IF_NO_CARRY:
+        case INSTR_JUMP_IF_NO_CARRY:
+        case INSTR_RETURN_IF_NO_CARRY:
+            *when_set = false;
+            return cpu.flag_carry;
+        case INSTR_CALL_IF_ZERO:
+        case INSTR_JUMP_IF_ZERO:
+        case INSTR_RETURN_IF_ZERO:
+            *when_set = true;
+            return cpu.flag_zero;
+        case INSTR_CALL_IF_NOT_ZERO:
+        case INSTR_JUMP_IF_NOT_ZERO:
+        case INSTR_RETURN_IF_NOT_ZERO:
+            *when_set = false;
+            return cpu.flag_zero;
+        case INSTR_CALL_IF_MINUS:
+        case INSTR_JUMP_IF_MINUS:
+        case INSTR_RETURN_IF_MINUS:
+            *when_set = true;
+            return cpu.flag_sign;
+        case INSTR_CALL_IF_PLUS:
+        case INSTR_JUMP_IF_PLUS:
+        case INSTR_RETURN_IF_PLUS:
+            *when_set = false;
+            return cpu.flag_sign;
+        case INSTR_CALL_IF_PARITY_EVEN:
+        case INSTR_JUMP_IF_PARITY_EVEN:
+        case INSTR_RETURN_IF_PARITY_EVEN:
+            *when_set = true;
+            return cpu.flag_parity;
+        case INSTR_CALL_IF_PARITY_ODD:
+        case INSTR_JUMP_IF_PARITY_ODD:
+        case INSTR_RETURN_IF_PARITY_ODD:
+            *when_set = false;
+            return cpu.flag_parity;
+        default:
+            return NULL;
+    }
+}
+
+// Lays out BLOCK_LEN copies of the instruction so that every copy
+// falls through (or branches) to the next one
+static void build_block(Instr decoded) {
+    memset(memory, 0, sizeof memory);
+
+    for (int i = 0; i < BLOCK_LEN; i++) {
+        uint16_t address = CODE_START + i * decoded.byte_count;
+        uint16_t next = address + decoded.byte_count;
+        uint16_t operand = DATA_ADDR;
+
+        if (is_branch_to_operand(decoded.type)) {
+            operand = next;
+        }
+
+        memory[address] = decoded.opcode;
+        if (decoded.byte_count == 2) {
+            memory[address + 1] = IO_PORT;
+        } else if (decoded.byte_count == 3) {
+            memory[address + 1] = operand & 0xff;
+            memory[address + 2] = operand >> 8;
+        }
+
+        // Return addresses for the RET family, popped in order
+        memory[STACK_TOP + i * 2] = next & 0xff;
+        memory[STACK_TOP + i * 2 + 1] = next >> 8;
+    }
+
+    // RST n lands on a RET back into the block
+    for (int n = 0; n < 8; n++) {
+        memory[n * 8] = 0xc9;
+    }
+
+    flush_decode_cache();
+}
+
+static void reset_registers(Instr decoded, bool flags) {
+    uint16_t hl = DATA_ADDR;
+
+    if (decoded.type == INSTR_LOAD_PROGRAM_COUNTER) {
+        // PCHL jumps back onto itself
+        hl = CODE_START;
+    } else if (decoded.type == INSTR_LOAD_SP_FROM_HL) {
+        hl = STACK_TOP;
+    }
+
+    *(cpu.pc) = CODE_START;
+    *(cpu.sp) = STACK_TOP;
+    *(cpu.reg_H) = hl >> 8;
+    *(cpu.reg_L) = hl & 0xff;
+    *(cpu.reg_B) = DATA_ADDR >> 8;
+    *(cpu.reg_C) = 0;
+    *(cpu.reg_D) = DATA_ADDR >> 8;
+    *(cpu.reg_E) = 0x80;
+    *(cpu.flag_sign) = flags;
+    *(cpu.flag_zero) = flags;
+    *(cpu.flag_parity) = flags;
+    *(cpu.flag_carry) = flags;
+    *(cpu.is_halted) = false;
+}
+
+// Returns ns per executed instruction
+static double time_instr(Instr decoded, bool flags, int instrs_per_copy) {
+    double best = 0;
+    int steps = BLOCK_LEN * instrs_per_copy;
+    bool is_halt = decoded.type == INSTR_HALT;
+
+    build_block(decoded);
+
+    for (int repeat = 0; repeat < REPEAT_COUNT; repeat++) {
+        uint64_t start = now_ns();
+
+        for (int block = 0; block < BLOCK_COUNT; block++) {
+            reset_registers(decoded, flags);
+            for (int i = 0; i < steps; i++) {
+                Instr instr = fetch_instr();
+                exec_instr(instr);
+                if (is_halt) {
+                    *(cpu.is_halted) = false;
+                }
+            }
+        }
+
+        double ns = (double)(now_ns() - start) / (BLOCK_COUNT * steps);
+        if (repeat == 0 || ns < best) {
+            best = ns;
+        }
+    }
+
+    return best;
+}
+
+static int run_all(Result *results) {
+    int count = 0;
+    double ret_ns;
+
+    init_cpu(memory);
+    cpu = expose_cpu_internals();
+
+    // RST is timed together with the RET that brings it back,
+    // so the cost of a plain RET is subtracted from it
+    ret_ns = time_instr(decode_opcode(0xc9), false, 1);
+
+    for (int opcode = 0; opcode < 256; opcode++) {
+        Instr decoded = decode_opcode(opcode);
+        bool when_set;
+        bool *flag = condition_flag(decoded.type, &when_set);
+        Result *result;
+
+        if (flag == NULL) {
+            result = &results[count++];
+            result->variant = VARIANT_NONE;
+            if (is_restart(decoded.type)) {
+                result->ns = 2 * time_instr(decoded, false, 2) - ret_ns;
+            } else {
+                result->ns = time_instr(decoded, false, 1);
+            }
+        } else {
+            result = &results[count++];
+            result->variant = VARIANT_TAKEN;
+            result->ns = time_instr(decoded, when_set, 1);
+            result->opcode = opcode;
+            result->type = decoded.type;
+            strcpy(result->mnemonic, get_disasm_info(opcode)->mnemonic);
+
+            result = &results[count++];
+            result->variant = VARIANT_NOT_TAKEN;
+            result->ns = time_instr(decoded, !when_set, 1);
+        }
+
+        result->opcode = opcode;
+        result->type = decoded.type;
+        strcpy(result->mnemonic, get_disasm_info(opcode)->mnemonic);
+    }
+
+    return count;
+}
+
+static int compare_results(const void *a, const void *b) {
+    const Result *x = a;
+    const Result *y = b;
+    if (x->type != y->type) {
+        return x->type < y->type ? -1 : 1;
+    }
+    if (x->opcode != y->opcode) {
+        return x->opcode < y->opcode ? -1 : 1;
+    }
+    return x->variant - y->variant;
+}
+
+static Variant parse_variant(char *name) {
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(name, variant_names[i]) == 0) {
+            return i;
+        }
+    }
+    return VARIANT_NONE;
+}
+
+// Reads a CSV previously written with -o
+static int load_baseline(char *path, Baseline *baseline) {
+    FILE *fp = fopen(path, "r");
+    char line[256];
+    int count = 0;
+
+    if (fp == NULL) {
+        printf("Error opening baseline %s\n", path);
+        exit(1);
+    }
+
+    // Skip header
+    fgets(line, sizeof line, fp);
+
+    while (fgets(line, sizeof line, fp) != NULL && count < 512) {
+        char backend[64], mnemonic[8], variant[16];
+        unsigned int opcode;
+        int type;
+        double ns;
+
+        variant[0] = '\0';
+        if (sscanf(line, "%63[^,],0x%x,%d,%7[^,],%15[^,],%lf",
+                   backend, &opcode, &type, mnemonic, variant, &ns) != 6 &&
+            sscanf(line, "%63[^,],0x%x,%d,%7[^,],,%lf",
+                   backend, &opcode, &type, mnemonic, &ns) != 5) {
+            continue;
+        }
+
+        baseline[count].opcode = opcode;
+        baseline[count].variant = parse_variant(variant);
+        baseline[count].ns = ns;
+        count++;
+    }
+
+    fclose(fp);
+    return count;
+}
+
+static Baseline *find_baseline(Baseline *baseline, int count, Result *r) {
+    for (int i = 0; i < count; i++) {
+        if (baseline[i].opcode == r->opcode &&
+            baseline[i].variant == r->variant) {
+            return &baseline[i];
+        }
+    }
+    return NULL;
+}
+
+static void print_results(Result *results, int count, Baseline *baseline,
+                          int baseline_count) {
+    int regressions = 0;
+
+    for (int i = 0; i < count; i++) {
+        Result *r = &results[i];
+
+        if (i == 0 || results[i - 1].type != r->type) {
+            printf("\n%s (type %d)\n", r->mnemonic, r->type);
+        }
+
+        printf("  0x%02x %-5s %-10s %7.2f ns", r->opcode, r->mnemonic,
+               variant_names[r->variant], r->ns);
+
+        Baseline *b = find_baseline(baseline, baseline_count, r);
+        if (b != NULL && b->ns > 0) {
+            double change = (r->ns - b->ns) / b->ns * 100;
+            printf("  %+6.1f%%", change);
+            if (change > regression_threshold) {
+                printf("  <<< REGRESSION");
+                regressions++;
+            }
+        }
+        printf("\n");
+    }
+
+    if (baseline_count > 0) {
+        printf("\n%d instruction(s) regressed by more than %.0f%%\n",
+               regressions, regression_threshold);
+    }
+}
+
+static void write_csv(char *path, Result *results, int count) {
+    FILE *fp = fopen(path, "w");
+
+    if (fp == NULL) {
+        printf("Error opening output file %s\n", path);
+        exit(1);
+    }
+
+    fprintf(fp, "backend,opcode,type,mnemonic,variant,ns_per_instr\n");
+    for (int i = 0; i < count; i++) {
+        Result *r = &results[i];
+        fprintf(fp, "%s,0x%02x,%d,%s,%s,%.3f\n", CPU_BACKEND, r->opcode,
+                r->type, r->mnemonic, variant_names[r->variant], r->ns);
+    }
+
+    fclose(fp);
+}
+
+int main(int argc, char *argv[]) {
+    static Result results[512];
+    static Baseline baseline[512];
+    int baseline_count = 0;
+    char *out_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:c:t:h")) != -1) {
+        switch (opt) {
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'c':
+                baseline_count = load_baseline(optarg, baseline);
+                break;
+            case 't':
+                regression_threshold = atof(optarg);
+                break;
+            default:
+                printf("Usage: %s [-o results.csv] [-c baseline.csv] "
+                       "[-t threshold_percent]\n", argv[0]);
+                exit(opt == 'h' ? 0 : 1);
+        }
+    }
+
+    int count = run_all(results);
+    qsort(results, count, sizeof(Result), compare_results);
+
+    printf("Backend: %s\n", CPU_BACKEND);
+    print_results(results, count, baseline, baseline_count);
+
+    if (out_path != NULL) {
+        write_csv(out_path, results, count);
+    }
+}
@@ -1,13 +1,97 @@
 
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "../cpu.h"
+#include "../profile.h"
+
+// Printed by CPUTEST around its timing section
+#define TIMING_BEGIN_TEXT "BEGIN TIMING TEST"
+#define TIMING_END_TEXT "END TIMING TEST"
+
+// Nested calls for the profiler check, deeper than its shadow stack
+#define PROFILE_CALL_DEPTH (MAX_PROFILE_DEPTH + 6)
+
+typedef struct TestRom {
+    char *path;
+    // Printed by the ROM only when every test passed
+    char *pass_text;
+    // Run each group of the exerciser's test table in its own process
+    bool split_groups;
+    // Only run when asked for with -x
+    bool is_extended;
+    // Cycles taken from 0x100 to the warm boot jump, 0 if not checked
+    uint64_t expected_cycles;
+    // Cycles between the timing section markers, 0 if not checked
+    uint64_t expected_timing_cycles;
+} TestRom;
+
+typedef struct TestRun {
+    TestRom *rom;
+    // Index into the exerciser's test table, or -1 for the whole ROM
+    int group;
+    pid_t pid;
+    int fd;
+    char *output;
+    size_t output_len;
+    size_t output_cap;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    bool running;
+    bool passed;
+    bool timed_out;
+    int crc_errors;
+    // Difference from the ROM's expected cycle count
+    int64_t cycle_error;
+    // Difference from the expected length of the timing section
+    int64_t timing_error;
+} TestRun;
+
+// The expected cycle counts are the ones published for these ROMs
+// (4924, 255653383 and 7817), less the 10 cycles of the OUT other
+// harnesses place at 0x0000 to stop the run. They only come out right
+// when every instruction, taken or not, costs what it does on an 8080,
+// so they catch timing regressions the output alone would not.
+// CPUTEST's timing section, a long counted loop around a JNZ, is
+// checked on its own as well, counted from the cycle the BDOS call
+// printing BEGIN TIMING TEST is entered to the one printing END.
+static TestRom test_roms[] = {
+    { "tests/TST8080.COM", "CPU IS OPERATIONAL", false, false, 4914, 0 },
+    { "tests/CPUTEST.COM", "CPU TESTS OK", false, false, 255653373,
+      252975520 },
+    { "tests/8080PRE.COM", "8080 Preliminary tests complete", false, false,
+      7807, 0 },
+    { "tests/8080EXM.COM", "Tests complete", true, false, 0, 0 },
+    { "tests/8080EXER.COM", "Tests complete", true, true, 0, 0 }
+};
+
+#define TEST_ROM_COUNT (int)(sizeof test_roms / sizeof test_roms[0])
+
+// A broken instruction can send a ROM into an endless loop, so runs
+// are killed after this long unless overridden with -t
+#define DEFAULT_TIMEOUT_SECONDS 1800
 
 uint8_t memory[65536];
 
+static CpuInnards cpu;
+static FILE *console = NULL;
+static bool finished = false;
+static int timeout_seconds = DEFAULT_TIMEOUT_SECONDS;
+
+// The last characters written to the console and the cycle counts at
+// the timing section markers
+static char recent_output[32];
+static uint64_t timing_begin_cycle = 0;
+static uint64_t timing_end_cycle = 0;
+
 void load_memory(char *path, uint16_t start_addr) {
     FILE *fp = fopen(path, "rb");
     size_t file_size = 0;
@@ -27,59 +111,520 @@ void load_memory(char *path, uint16_t start_addr) {
     fclose(fp);
 }
 
-void run_test(char *path) {
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// The exercisers walk their test table with
+//   lxi h,tests / loop: mov a,m / inx h / ora m / jz done
+// so the table address is found by matching that code
+static uint16_t find_test_table() {
+    static const uint8_t loop_code[] = { 0x7e, 0x23, 0xb6, 0xca };
+
+    for (int addr = 0x103; addr < 0x1000; addr++) {
+        if (memory[addr - 3] == 0x21 &&
+            memcmp(&memory[addr], loop_code, sizeof loop_code) == 0) {
+            return memory[addr - 2] | ((uint16_t)memory[addr - 1] << 8);
+        }
+    }
+
+    printf("Error: exerciser test table not found\n");
+    exit(1);
+}
+
+// The table is a list of test descriptor addresses ending with 0
+static int count_test_groups(char *path) {
+    load_memory(path, 0x100);
+
+    uint16_t table = find_test_table();
+    int count = 0;
+    while (memory[table + count * 2] | memory[table + count * 2 + 1]) {
+        count++;
+    }
+    return count;
+}
+
+// Patches the table so that only `group` runs
+static void select_test_group(int group) {
+    uint16_t table = find_test_table();
+
+    memory[table] = memory[table + group * 2];
+    memory[table + 1] = memory[table + group * 2 + 1];
+    memory[table + 2] = 0;
+    memory[table + 3] = 0;
+}
+
+static bool ends_with(const char *text, size_t len, const char *suffix) {
+    size_t suffix_len = strlen(suffix);
+    return len >= suffix_len &&
+           memcmp(text + len - suffix_len, suffix, suffix_len) == 0;
+}
+
+// Stamps the cycle count when CPUTEST prints the start and the end of
+// its timing section
+static void write_console(char c) {
+    fputc(c, console);
+
+    memmove(recent_output, recent_output + 1, sizeof recent_output - 1);
+    recent_output[sizeof recent_output - 1] = c;
+
+    if (ends_with(recent_output, sizeof recent_output, TIMING_BEGIN_TEXT)) {
+        timing_begin_cycle = get_cycle_count();
+    } else if (ends_with(recent_output, sizeof recent_output,
+                         TIMING_END_TEXT)) {
+        timing_end_cycle = get_cycle_count();
+    }
+}
+
+// CP/M BDOS entry point
+static void bdos_call(uint16_t address) {
+    (void)address;
+
+    // Prints characters stored in memory at (DE)
+    // until character '$' (0x24 in ASCII) is found
+    if (*(cpu.reg_C) == 9) {
+        uint16_t addr = ((uint16_t)(*(cpu.reg_D)) << 8) | *(cpu.reg_E);
+        while (memory[addr] != 0x24) {
+            write_console(memory[addr]);
+            addr++;
+        }
+    }
+
+    // Prints a single character stored in register E,
+    // skipping the NUL padding CPUTEST sends to the terminal
+    if (*(cpu.reg_C) == 2 && *(cpu.reg_E) != 0) {
+        write_console(*(cpu.reg_E));
+    }
+}
+
+// The test ROMs finish by jumping to the CP/M warm boot at 0x0000
+static void warm_boot(uint16_t address) {
+    (void)address;
+    fprintf(console, "\nJumped to 0x0000\n");
+    finished = true;
+}
+
+// Runs in the forked child, writing the console output to `out`
+void run_test(char *path, int group, FILE *out) {
     Instr instr;
 
+    console = out;
+    finished = false;
+    memset(recent_output, 0, sizeof recent_output);
+    timing_begin_cycle = 0;
+    timing_end_cycle = 0;
+
     init_cpu(memory);
     load_memory(path, 0x100);
+    if (group >= 0) {
+        select_test_group(group);
+    }
 
-    CpuInnards cpu = expose_cpu_internals();
+    cpu = expose_cpu_internals();
 
     // Test ROMs start at 0x100
     *(cpu.pc) = 0x100;
 
-    // Inject RET at 0x5 to handle "CALL 5"
-    memory[5] = 0xc9;
+    // Inject OUT 0; RET at 0x5 to return from "CALL 5", the same
+    // stub the published cycle counts were measured with
+    memory[5] = 0xd3;
+    memory[6] = 0x00;
+    memory[7] = 0xc9;
 
-    printf("*******************\n");
+    clear_pc_hooks();
+    register_pc_hook(0x0005, bdos_call);
+    register_pc_hook(0x0000, warm_boot);
+
+    // Nothing raises interrupts here, so fusing is only limited by the
+    // hooks, which also puts the fused instructions under test
+    while (!finished) {
+        instr = fetch_fused_instr(INT_MAX);
+        // Don't count the instruction at the warm boot address
+        if (finished) {
+            break;
+        }
+        exec_instr(instr);
+
+        if (*(cpu.is_halted)) {
+            fprintf(console, "\nHLT at %04x\n", *(cpu.pc) - 1);
+            break;
+        }
+    }
+
+    fprintf(console, "Cycles: %llu\n",
+            (unsigned long long)get_cycle_count());
+    if (timing_end_cycle > timing_begin_cycle) {
+        fprintf(console, "Timing cycles: %llu\n",
+                (unsigned long long)(timing_end_cycle - timing_begin_cycle));
+    }
+
+    fflush(console);
+}
+
+static void start_run(TestRun *run) {
+    int fds[2];
+
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        exit(1);
+    }
 
-    while (true) {
-        if (memory[*(cpu.pc)] == 0x76) {
-            printf("HLT at %04x\n", *(cpu.pc));
+    run->start_ns = now_ns();
+    run->pid = fork();
+    if (run->pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+
+    if (run->pid == 0) {
+        alarm(timeout_seconds);
+        close(fds[0]);
+        FILE *out = fdopen(fds[1], "w");
+        run_test(run->rom->path, run->group, out);
+        fclose(out);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    run->fd = fds[0];
+    run->running = true;
+}
+
+static void append_output(TestRun *run, char *buf, size_t len) {
+    if (run->output_len + len + 1 > run->output_cap) {
+        run->output_cap = (run->output_len + len + 1) * 2;
+        run->output = realloc(run->output, run->output_cap);
+    }
+    memcpy(run->output + run->output_len, buf, len);
+    run->output_len += len;
+    run->output[run->output_len] = '\0';
+}
+
+static void check_output(TestRun *run, int status) {
+    char *line;
+
+    run->timed_out = WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM;
+    if (run->timed_out) {
+        char message[64];
+        snprintf(message, sizeof message, "\nTimed out after %d s\n",
+                 timeout_seconds);
+        append_output(run, message, strlen(message));
+    }
+
+    if (run->output == NULL) {
+        append_output(run, "", 0);
+    }
+
+    run->crc_errors = 0;
+    line = run->output;
+    while ((line = strstr(line, "ERROR **** crc expected")) != NULL) {
+        run->crc_errors++;
+        line++;
+    }
+
+    run->cycle_error = 0;
+    if (run->group < 0 && run->rom->expected_cycles > 0) {
+        unsigned long long cycles = 0;
+        line = strstr(run->output, "Cycles: ");
+        if (line != NULL) {
+            sscanf(line, "Cycles: %llu", &cycles);
         }
+        run->cycle_error = (int64_t)(cycles - run->rom->expected_cycles);
+    }
 
-        if (*(cpu.pc) == 5) {
-            // Prints characters stored in memory at (DE)
-            // until character '$' (0x24 in ASCII) is found
-            if (*(cpu.reg_C) == 9) {
-                uint16_t addr = ((uint16_t)(*(cpu.reg_D)) << 8) | *(cpu.reg_E);
-                do {
-                    printf("%c", memory[addr]);
-                    addr++;
-                } while (memory[addr] != 0x24);
+    run->timing_error = 0;
+    if (run->group < 0 && run->rom->expected_timing_cycles > 0) {
+        unsigned long long cycles = 0;
+        line = strstr(run->output, "Timing cycles: ");
+        if (line != NULL) {
+            sscanf(line, "Timing cycles: %llu", &cycles);
+        }
+        run->timing_error = (int64_t)(cycles -
+                                      run->rom->expected_timing_cycles);
+    }
+
+    run->passed = run->cycle_error == 0 && run->timing_error == 0 &&
+                  WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+                  strstr(run->output, run->rom->pass_text) != NULL &&
+                  strstr(run->output, "ERROR") == NULL &&
+                  strstr(run->output, "FAILED") == NULL &&
+                  strstr(run->output, "HLT at") == NULL;
+}
+
+// The line between the exerciser's banner and its closing message
+static char *get_group_result(TestRun *run) {
+    static char line[256];
+    char *start = strchr(run->output, '\n');
+
+    if (start == NULL) {
+        return "no output\n";
+    }
+    start++;
+
+    char *end = strchr(start, '\n');
+    size_t len = end != NULL ? (size_t)(end - start + 1) : strlen(start);
+    if (len >= sizeof line) {
+        len = sizeof line - 1;
+    }
+    memcpy(line, start, len);
+    line[len] = '\0';
+    return line;
+}
+
+static void finish_run(TestRun *run) {
+    int status;
+
+    close(run->fd);
+    waitpid(run->pid, &status, 0);
+    run->end_ns = now_ns();
+    run->running = false;
+
+    check_output(run, status);
+
+    if (run->group < 0) {
+        printf("******************* %s\n", run->rom->path);
+        printf("%s", run->output);
+    } else {
+        printf("%s #%02d: %s", run->rom->path, run->group,
+               get_group_result(run));
+    }
+    fflush(stdout);
+}
+
+// Runs every ROM in its own process, at most `jobs` at a time
+static void run_all(TestRun *runs, int count, int jobs) {
+    struct pollfd *fds = malloc(count * sizeof(struct pollfd));
+    TestRun **polled = malloc(count * sizeof(TestRun *));
+    int next = 0;
+    int done = 0;
+    char buf[4096];
+
+    while (done < count) {
+        int running = 0;
+        for (int i = 0; i < count; i++) {
+            running += runs[i].running;
+        }
+        while (running < jobs && next < count) {
+            start_run(&runs[next++]);
+            running++;
+        }
+
+        int nfds = 0;
+        for (int i = 0; i < count; i++) {
+            if (runs[i].running) {
+                fds[nfds].fd = runs[i].fd;
+                fds[nfds].events = POLLIN;
+                polled[nfds] = &runs[i];
+                nfds++;
+            }
+        }
+
+        if (poll(fds, nfds, -1) < 0) {
+            perror("poll");
+            exit(1);
+        }
+
+        for (int i = 0; i < nfds; i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP))) {
+                continue;
             }
 
-            // Prints a single character stored in register E
-            if (*(cpu.reg_C) == 2) {
-                printf("%c", *(cpu.reg_E));
+            ssize_t len = read(fds[i].fd, buf, sizeof buf);
+            if (len > 0) {
+                append_output(polled[i], buf, len);
+            } else {
+                finish_run(polled[i]);
+                done++;
             }
         }
+    }
 
-        // Execute instruction as one normally would do
-        instr = fetch_instr();
-        //printf("INSTR: %02x: %s\n", instr.address, instr.mnemonic);
-        exec_instr(instr);
+    free(fds);
+    free(polled);
+}
+
+static int get_run_count(TestRom *rom) {
+    int groups = rom->split_groups ? count_test_groups(rom->path) : 0;
+    return groups > 0 ? groups : 1;
+}
+
+// Returns the number of runs added for `rom`
+static int add_runs(TestRun *runs, TestRom *rom) {
+    int groups = rom->split_groups ? count_test_groups(rom->path) : 0;
 
-        if (*(cpu.pc) == 0) {
-            printf("\nJumped to 0x0000\n");
+    if (groups == 0) {
+        runs[0].rom = rom;
+        runs[0].group = -1;
+        return 1;
+    }
+
+    for (int i = 0; i < groups; i++) {
+        runs[i].rom = rom;
+        runs[i].group = i;
+    }
+    return groups;
+}
+
+// Combines the runs of one ROM into a single line of the summary
+static bool report_rom(TestRom *rom, TestRun *runs, int count) {
+    uint64_t start = 0;
+    uint64_t end = 0;
+    bool passed = true;
+    bool found = false;
+    int crc_errors = 0;
+    int64_t cycle_error = 0;
+    int64_t timing_error = 0;
+
+    for (int i = 0; i < count; i++) {
+        TestRun *run = &runs[i];
+        if (run->rom != rom) {
+            continue;
+        }
+        if (!found || run->start_ns < start) {
+            start = run->start_ns;
+        }
+        if (!found || run->end_ns > end) {
+            end = run->end_ns;
+        }
+        found = true;
+        passed = passed && run->passed;
+        crc_errors += run->crc_errors;
+        cycle_error += run->cycle_error;
+        timing_error += run->timing_error;
+    }
+
+    if (!found) {
+        return true;
+    }
+
+    printf("%-20s %s %8.2f s", rom->path, passed ? "PASS" : "FAIL",
+           (end - start) / 1e9);
+    if (crc_errors > 0) {
+        printf("  (%d CRC mismatches)", crc_errors);
+    }
+    if (cycle_error != 0) {
+        printf("  (cycle count off by %lld)", (long long)cycle_error);
+    }
+    if (timing_error != 0) {
+        printf("  (timing section off by %lld)", (long long)timing_error);
+    }
+    printf("\n");
+    return passed;
+}
+
+// Calls nested past MAX_PROFILE_DEPTH have to fold into the deepest
+// frame, and reset_profile() has to drop them again
+static bool check_profile_depth() {
+    FILE *fp = tmpfile();
+    char line[1024];
+    int max_frames = 0;
+    uint64_t total_cycles = 0;
+    int path_count = 0;
+    bool passed;
+
+    reset_profile();
+    for (int i = 0; i < PROFILE_CALL_DEPTH; i++) {
+        profile_call(0x1000 + i, 0x2000 + i);
+        profile_instr(0x1000 + i, 4);
+    }
+    write_collapsed_stacks(fp);
+
+    rewind(fp);
+    while (fgets(line, sizeof line, fp) != NULL) {
+        int frames = 1;
+        for (char *c = line; *c != '\0'; c++) {
+            frames += *c == ';';
+        }
+        if (frames > max_frames) {
+            max_frames = frames;
+        }
+        total_cycles += strtoull(strrchr(line, ' ') + 1, NULL, 10);
+    }
+    passed = max_frames == MAX_PROFILE_DEPTH &&
+             total_cycles == PROFILE_CALL_DEPTH * 4;
+
+    fclose(fp);
+
+    // The root and one node per frame, none for the folded calls
+    fp = tmpfile();
+    write_profile_summary(fp);
+    rewind(fp);
+    while (fgets(line, sizeof line, fp) != NULL) {
+        if (sscanf(line, "call paths: %d", &path_count) == 1) {
             break;
         }
     }
+    passed = passed && path_count == MAX_PROFILE_DEPTH;
+    fclose(fp);
+
+    // Only the root should be left after a reset
+    reset_profile();
+    profile_instr(0x0000, 4);
+    fp = tmpfile();
+    write_collapsed_stacks(fp);
+    rewind(fp);
+    passed = passed && fgets(line, sizeof line, fp) != NULL &&
+             strcmp(line, "sub_0000 4\n") == 0 &&
+             fgets(line, sizeof line, fp) == NULL;
+    fclose(fp);
+
+    printf("%-20s %s\n", "profiler depth", passed ? "PASS" : "FAIL");
+    return passed;
 }
 
 int main(int argc, char *argv[]) {
-    run_test("tests/TST8080.COM");
-    run_test("tests/CPUTEST.COM");
-    run_test("tests/8080PRE.COM");
-    run_test("tests/8080EXM.COM");
+    TestRun *runs;
+    int run_count = 0;
+    int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    bool extended = false;
+    int failures = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:t:xh")) != -1) {
+        switch (opt) {
+            case 'j':
+                jobs = atoi(optarg);
+                break;
+            case 't':
+                timeout_seconds = atoi(optarg);
+                break;
+            case 'x':
+                extended = true;
+                break;
+            default:
+                printf("Usage: %s [-j jobs] [-t timeout_seconds] [-x]\n",
+                       argv[0]);
+                exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    }
+
+    for (int i = 0; i < TEST_ROM_COUNT; i++) {
+        if (!test_roms[i].is_extended || extended) {
+            run_count += get_run_count(&test_roms[i]);
+        }
+    }
+
+    runs = calloc(run_count, sizeof(TestRun));
+    run_count = 0;
+    for (int i = 0; i < TEST_ROM_COUNT; i++) {
+        if (!test_roms[i].is_extended || extended) {
+            run_count += add_runs(&runs[run_count], &test_roms[i]);
+        }
+    }
+
+    run_all(runs, run_count, jobs);
+
+    printf("*******************\n");
+    for (int i = 0; i < TEST_ROM_COUNT; i++) {
+        failures += !report_rom(&test_roms[i], runs, run_count);
+    }
+    failures += !check_profile_depth();
+
+    free(runs);
+    return failures == 0 ? 0 : 1;
 }
@@ -6,6 +6,10 @@
 #include <stdio.h>
 
 #include "cpu.h"
+#include "opcodes.h"
+#include "opstats.h"
+#include "profile.h"
+#include "trace.h"
 
 static uint16_t pc = 0;
 static uint16_t sp = 0;
@@ -27,10 +31,64 @@ static bool flag_carry = false;
 static bool is_halted = false;
 static bool is_interruptible = true;
 
+// Set by EI for the instruction that follows it, which always runs
+// before a pending interrupt is accepted
+static bool is_enable_delayed = false;
+
+// Interrupt raised by the hardware and not yet accepted
+static bool is_interrupt_pending = false;
+static uint8_t pending_interrupt_opcode = 0;
+
+static uint64_t cycle_counter = 0;
+
 static uint8_t *memory = NULL;
 
 static uint8_t input_ports[256] = {0};
 static uint8_t output_ports[256] = {0};
+static InputHook input_hooks[256] = {0};
+
+typedef struct PcHookEntry {
+    uint16_t address;
+    PcHook hook;
+} PcHookEntry;
+
+static PcHookEntry pc_hooks[MAX_PC_HOOKS];
+static int pc_hook_count = 0;
+
+// One bit per address with a hook, plus one bit per 256 byte block
+// telling whether any address in the block has one, so the common
+// case is a single bit test
+static uint8_t pc_hook_bitmap[65536 / 8];
+static uint8_t pc_hook_blocks[256 / 8];
+
+typedef struct Watchpoint {
+    uint16_t start;
+    uint16_t end;
+    uint8_t access;
+    WatchHook hook;
+} Watchpoint;
+
+static Watchpoint watchpoints[MAX_WATCHPOINTS];
+static int watchpoint_count = 0;
+
+// WATCH_READ/WATCH_WRITE bits of every watchpoint overlapping each
+// 256 byte page. Data accesses only leave the fast path on pages with
+// a matching bit set.
+static uint8_t page_watch_flags[256];
+
+static TraceRing *trace_ring = NULL;
+
+// Decoded instructions by address. Entries with a byte_count of 0 are
+// decoded again on the next fetch.
+static Instr decode_cache[65536];
+
+// Wraps the condition of conditional JMP/CALL/RET so the statistics
+// build can count which way they went
+#ifdef CPU_OPCODE_STATS
+#define BRANCH_TAKEN(cond) count_branch(instr.opcode, (cond))
+#else
+#define BRANCH_TAKEN(cond) (cond)
+#endif
 
 void init_cpu(uint8_t *mem) {
     memory = mem;
@@ -54,8 +112,22 @@ void init_cpu(uint8_t *mem) {
 
     is_halted = false;
     is_interruptible = true;
+    is_enable_delayed = false;
+    is_interrupt_pending = false;
+
+    cycle_counter = 0;
+
+    flush_decode_cache();
+
+#ifdef CPU_PROFILE
+    reset_profile();
+#endif
+#ifdef CPU_OPCODE_STATS
+    reset_opcode_stats(&opcode_stats);
+#endif
 
     memset(input_ports, 0, 256);
+    memset(input_hooks, 0, sizeof input_hooks);
     memset(output_ports, 0, 256);
 }
 
@@ -88,1105 +160,323 @@ CpuInnards expose_cpu_internals() {
     return cpu;
 }
 
-Instr populate_instr(InstrType type, char *mnemonic, int cycle_count,
-        int byte_count, InstrOpType op_type) {
-    Instr instr;
-
-    instr.address = pc;
-    instr.opcode = memory[pc];
-    instr.type = type;
-    strcpy(instr.mnemonic, mnemonic);
-    instr.cycle_count = cycle_count;
-    instr.byte_count = byte_count;
-
-    instr.op_type = op_type;
-    if (op_type == INSTR_OP_REG_B_AND_OP_8 ||
-        op_type == INSTR_OP_REG_C_AND_OP_8 ||
-        op_type == INSTR_OP_REG_D_AND_OP_8 ||
-        op_type == INSTR_OP_REG_E_AND_OP_8 ||
-        op_type == INSTR_OP_REG_H_AND_OP_8 ||
-        op_type == INSTR_OP_REG_L_AND_OP_8 ||
-        op_type == INSTR_OP_REG_A_AND_OP_8 ||
-        op_type == INSTR_OP_MEM_REF_AND_OP_8 ||
-        op_type == INSTR_OP_SINGLE_8) {
-        instr.operand_8_1 = memory[pc+1];
-    }
-    if (op_type == INSTR_OP_DOUBLE_8) {
-        instr.operand_8_1 = memory[pc+1];
-        instr.operand_8_2 = memory[pc+2];
+// Total cycles executed since init_cpu
+uint64_t get_cycle_count() {
+    return cycle_counter;
+}
+
+// Every executed instruction is recorded into `ring` until this is
+// called again with NULL
+void set_trace_ring(TraceRing *ring) {
+    trace_ring = ring;
+}
+
+// The CPU notices its own writes to code, anything else writing to
+// memory that has already been executed has to call this
+void flush_decode_cache() {
+    memset(decode_cache, 0, sizeof decode_cache);
+}
+
+// Drops every cached instruction that could cover `address`
+static inline void invalidate_decoded(uint16_t address) {
+    decode_cache[address].byte_count = 0;
+    decode_cache[(uint16_t)(address - 1)].byte_count = 0;
+    decode_cache[(uint16_t)(address - 2)].byte_count = 0;
+}
+
+static void update_pc_hook_bits(uint16_t address) {
+    bool armed = false;
+    uint8_t block = address >> 8;
+
+    for (int i = 0; i < pc_hook_count; i++) {
+        if (pc_hooks[i].address == address) {
+            armed = true;
+        }
     }
-    if (op_type == INSTR_OP_REG_PAIR_B_AND_OP_16 ||
-        op_type == INSTR_OP_REG_PAIR_D_AND_OP_16 ||
-        op_type == INSTR_OP_REG_PAIR_H_AND_OP_16 ||
-        op_type == INSTR_OP_REG_PAIR_SP_AND_OP_16 ||
-        op_type == INSTR_OP_16) {
-        instr.operand_16 = (memory[pc+1] << 8) + memory[pc+2];
+    if (armed) {
+        pc_hook_bitmap[address >> 3] |= 1 << (address & 0x7);
+    } else {
+        pc_hook_bitmap[address >> 3] &= ~(1 << (address & 0x7));
     }
 
-    if (instr.type == INSTR_MOVE) {
-        int op_src = instr.opcode & 0x7;
-        int op_dest = (instr.opcode >> 3) & 0x7;
-
-        switch (op_src) {
-            case 0:
-                instr.move_source = INSTR_OP_REG_B;
-                break;
-            case 1:
-                instr.move_source = INSTR_OP_REG_C;
-                break;
-            case 2:
-                instr.move_source = INSTR_OP_REG_D;
-                break;
-            case 3:
-                instr.move_source = INSTR_OP_REG_E;
-                break;
-            case 4:
-                instr.move_source = INSTR_OP_REG_H;
-                break;
-            case 5:
-                instr.move_source = INSTR_OP_REG_L;
-                break;
-            case 6:
-                instr.move_source = INSTR_OP_MEM_REF;
-                break;
-            case 7:
-                instr.move_source = INSTR_OP_REG_A;
-                break;
+    armed = false;
+    for (int i = block * 32; i < (block + 1) * 32; i++) {
+        if (pc_hook_bitmap[i]) {
+            armed = true;
         }
+    }
+    if (armed) {
+        pc_hook_blocks[block >> 3] |= 1 << (block & 0x7);
+    } else {
+        pc_hook_blocks[block >> 3] &= ~(1 << (block & 0x7));
+    }
+}
 
-        switch (op_dest) {
-            case 0:
-                instr.move_destination = INSTR_OP_REG_B;
-                break;
-            case 1:
-                instr.move_destination = INSTR_OP_REG_C;
-                break;
-            case 2:
-                instr.move_destination = INSTR_OP_REG_D;
-                break;
-            case 3:
-                instr.move_destination = INSTR_OP_REG_E;
-                break;
-            case 4:
-                instr.move_destination = INSTR_OP_REG_H;
-                break;
-            case 5:
-                instr.move_destination = INSTR_OP_REG_L;
-                break;
-            case 6:
-                instr.move_destination = INSTR_OP_MEM_REF;
-                break;
-            case 7:
-                instr.move_destination = INSTR_OP_REG_A;
-                break;
+// Hooks are run before the instruction at their address is fetched.
+// They are kept across init_cpu so they can be registered up front.
+// Builds with NO_CPU_HOOKS never check for them, so registering fails.
+bool register_pc_hook(uint16_t address, PcHook hook) {
+#ifdef NO_CPU_HOOKS
+    (void)address;
+    (void)hook;
+    return false;
+#else
+    if (pc_hook_count == MAX_PC_HOOKS) {
+        return false;
+    }
+
+    pc_hooks[pc_hook_count].address = address;
+    pc_hooks[pc_hook_count].hook = hook;
+    pc_hook_count++;
+    update_pc_hook_bits(address);
+    return true;
+#endif
+}
+
+void remove_pc_hook(uint16_t address, PcHook hook) {
+    for (int i = 0; i < pc_hook_count; i++) {
+        if (pc_hooks[i].address == address && pc_hooks[i].hook == hook) {
+            pc_hooks[i] = pc_hooks[pc_hook_count - 1];
+            pc_hook_count--;
+            break;
         }
     }
+    update_pc_hook_bits(address);
+}
 
-    return instr;
+void clear_pc_hooks() {
+    pc_hook_count = 0;
+    memset(pc_hook_bitmap, 0, sizeof pc_hook_bitmap);
+    memset(pc_hook_blocks, 0, sizeof pc_hook_blocks);
 }
 
-Instr fetch_instr() {
-    Instr instr;
+#ifndef NO_CPU_HOOKS
+static void run_pc_hooks() {
+    if (!(pc_hook_bitmap[pc >> 3] & (1 << (pc & 0x7)))) {
+        return;
+    }
 
-    uint8_t opcode = memory[pc];
+    uint16_t address = pc;
+    for (int i = 0; i < pc_hook_count; i++) {
+        if (pc_hooks[i].address == address) {
+            pc_hooks[i].hook(address);
+        }
+    }
+}
+#endif
 
-    // temporarily fill out some default values
-    instr.type = INSTR_NOP;
-    strcpy(instr.mnemonic, "999");
-    instr.cycle_count = 999;
-    instr.byte_count = 999;
-    instr.address = pc;
-    instr.opcode = opcode;
+static void update_page_watch_flags() {
+    memset(page_watch_flags, 0, sizeof page_watch_flags);
 
-    switch (opcode) {
-        case 0x00:
-            instr = populate_instr(INSTR_NOP, "NOP", 4, 1, INSTR_OP_NONE);
-            break;
-        case 0x01:
-            instr = populate_instr(INSTR_LOAD_REG_PAIR_IMMEDIATE, "LXI", 10, 3,
-                                   INSTR_OP_REG_PAIR_B_AND_OP_16);
-            break;
-        case 0x02:
-            instr = populate_instr(INSTR_STORE_ACCUMULATOR, "STAX", 7, 1,
-                                   INSTR_OP_REG_PAIR_B);
-            break;
-        case 0x03:
-            instr = populate_instr(INSTR_INCREMENT_REG_PAIR, "INX", 5, 1,
-                                   INSTR_OP_REG_PAIR_B);
-            break;
-        case 0x04:
-            instr = populate_instr(INSTR_INCREMENT_REG, "INR", 5, 1,
-                                   INSTR_OP_REG_B);
-            break;
-        case 0x05:
-            instr = populate_instr(INSTR_DECREMENT_REG, "DCR", 5, 1,
-                                   INSTR_OP_REG_B);
-            break;
-        case 0x06:
-            instr = populate_instr(INSTR_MOVE_IMMEDIATE, "MVI", 7, 2,
-                                   INSTR_OP_REG_B_AND_OP_8);
-            break;
-        case 0x07:
-            instr = populate_instr(INSTR_ROTATE_ACCUMULATOR_LEFT, "RLC",
-                                   4, 1, INSTR_OP_NONE);
-            break;
-        case 0x08:
-            instr = populate_instr(INSTR_NOP, "NOP", 4, 1, INSTR_OP_NONE);
-            break;
-        case 0x09:
-            instr = populate_instr(INSTR_DOUBLE_ADD, "DAD", 10, 1,
-                                   INSTR_OP_REG_PAIR_B);
-            break;
-        case 0x0a:
-            instr = populate_instr(INSTR_LOAD_ACCUMULATOR, "LDAX", 7, 1,
-                                   INSTR_OP_REG_PAIR_B);
-            break;
-        case 0x0b:
-            instr = populate_instr(INSTR_DECREMENT_REG_PAIR, "DCX", 5, 1,
-                                   INSTR_OP_REG_PAIR_B);
-            break;
-        case 0x0c:
-            instr = populate_instr(INSTR_INCREMENT_REG, "INR", 5, 1,
-                                   INSTR_OP_REG_C);
-            break;
-        case 0x0d:
-            instr = populate_instr(INSTR_DECREMENT_REG, "DCR", 5, 1,
-                                   INSTR_OP_REG_C);
-            break;
-        case 0x0e:
-            instr = populate_instr(INSTR_MOVE_IMMEDIATE, "MVI", 7, 2,
-                                   INSTR_OP_REG_C_AND_OP_8);
-            break;
-        case 0x0f:
-            instr = populate_instr(INSTR_ROTATE_ACCUMULATOR_RIGHT, "RRC",
-                                   4, 1, INSTR_OP_NONE);
-            break;
-        case 0x10:
-            instr = populate_instr(INSTR_NOP, "NOP", 4, 1, INSTR_OP_NONE);
-            break;
-        case 0x11:
-            instr = populate_instr(INSTR_LOAD_REG_PAIR_IMMEDIATE, "LXI", 10, 3,
-                                   INSTR_OP_REG_PAIR_D_AND_OP_16);
-            break;
-        case 0x12:
-            instr = populate_instr(INSTR_STORE_ACCUMULATOR, "STAX", 7, 1,
-                                   INSTR_OP_REG_PAIR_D);
-            break;
-        case 0x13:
-            instr = populate_instr(INSTR_INCREMENT_REG_PAIR, "INX", 5, 1,
-                                   INSTR_OP_REG_PAIR_D);
-            break;
-        case 0x14:
-            instr = populate_instr(INSTR_INCREMENT_REG, "INR", 5, 1,
-                                   INSTR_OP_REG_D);
-            break;
-        case 0x15:
-            instr = populate_instr(INSTR_DECREMENT_REG, "DCR", 5, 1,
-                                   INSTR_OP_REG_D);
-            break;
-        case 0x16:
-            instr = populate_instr(INSTR_MOVE_IMMEDIATE, "MVI", 7, 2,
-                                   INSTR_OP_REG_D_AND_OP_8);
-            break;
-        case 0x17:
-            instr = populate_instr(INSTR_ROTATE_ACCUMULATOR_LEFT_CARRY, "RAL",
-                                   4, 1, INSTR_OP_NONE);
-            break;
-        case 0x18:
-            instr = populate_instr(INSTR_NOP, "NOP", 4, 1, INSTR_OP_NONE);
-            break;
-        case 0x19:
-            instr = populate_instr(INSTR_DOUBLE_ADD, "DAD", 10, 1,
-                                   INSTR_OP_REG_PAIR_D);
-            break;
-        case 0x1a:
-            instr = populate_instr(INSTR_LOAD_ACCUMULATOR, "LDAX", 7, 1,
-                                   INSTR_OP_REG_PAIR_D);
-            break;
-        case 0x1b:
-            instr = populate_instr(INSTR_DECREMENT_REG_PAIR, "DCX", 5, 1,
-                                   INSTR_OP_REG_PAIR_D);
-            break;
-        case 0x1c:
-            instr = populate_instr(INSTR_INCREMENT_REG, "INR", 5, 1,
-                                   INSTR_OP_REG_E);
-            break;
-        case 0x1d:
-            instr = populate_instr(INSTR_DECREMENT_REG, "DCR", 5, 1,
-                                   INSTR_OP_REG_E);
-            break;
-        case 0x1e:
-            instr = populate_instr(INSTR_MOVE_IMMEDIATE, "MVI", 7, 2,
-                                   INSTR_OP_REG_E_AND_OP_8);
-            break;
-        case 0x1f:
-            instr = populate_instr(INSTR_ROTATE_ACCUMULATOR_RIGHT_CARRY, "RAR",
-                                   4, 1, INSTR_OP_NONE);
-            break;
-        case 0x20:
-            instr = populate_instr(INSTR_NOP, "NOP", 4, 1, INSTR_OP_NONE);
-            break;
-        case 0x21:
-            instr = populate_instr(INSTR_LOAD_REG_PAIR_IMMEDIATE, "LXI", 10, 3,
-                                   INSTR_OP_REG_PAIR_H_AND_OP_16);
-            break;
-        case 0x22:
-            instr = populate_instr(INSTR_STORE_HL_DIRECT, "SHLD", 16, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0x23:
-            instr = populate_instr(INSTR_INCREMENT_REG_PAIR, "INX", 5, 1,
-                                   INSTR_OP_REG_PAIR_H);
-            break;
-        case 0x24:
-            instr = populate_instr(INSTR_INCREMENT_REG, "INR", 5, 1,
-                                   INSTR_OP_REG_H);
-            break;
-        case 0x25:
-            instr = populate_instr(INSTR_DECREMENT_REG, "DCR", 5, 1,
-                                   INSTR_OP_REG_H);
-            break;
-        case 0x26:
-            instr = populate_instr(INSTR_MOVE_IMMEDIATE, "MVI", 7, 2,
-                                   INSTR_OP_REG_H_AND_OP_8);
-            break;
-        case 0x27:
-            instr = populate_instr(INSTR_DECIMAL_ADJUST_ACCUMULATOR, "DAA",
-                                   4, 1, INSTR_OP_NONE);
-            break;
-        case 0x28:
-            instr = populate_instr(INSTR_NOP, "NOP", 4, 1, INSTR_OP_NONE);
-            break;
-        case 0x29:
-            instr = populate_instr(INSTR_DOUBLE_ADD, "DAD", 10, 1,
-                                   INSTR_OP_REG_PAIR_H);
-            break;
-        case 0x2a:
-            instr = populate_instr(INSTR_LOAD_HL_DIRECT, "LHLD", 16, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0x2b:
-            instr = populate_instr(INSTR_DECREMENT_REG_PAIR, "DCX", 5, 1,
-                                   INSTR_OP_REG_PAIR_H);
-            break;
-        case 0x2c:
-            instr = populate_instr(INSTR_INCREMENT_REG, "INR", 5, 1,
-                                   INSTR_OP_REG_L);
-            break;
-        case 0x2d:
-            instr = populate_instr(INSTR_DECREMENT_REG, "DCR", 5, 1,
-                                   INSTR_OP_REG_L);
-            break;
-        case 0x2e:
-            instr = populate_instr(INSTR_MOVE_IMMEDIATE, "MVI", 7, 2,
-                                   INSTR_OP_REG_L_AND_OP_8);
-            break;
-        case 0x2f:
-            instr = populate_instr(INSTR_COMPLEMENT_ACCUMULATOR, "CMA", 4, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0x30:
-            instr = populate_instr(INSTR_NOP, "NOP", 4, 1, INSTR_OP_NONE);
-            break;
-        case 0x31:
-            instr = populate_instr(INSTR_LOAD_REG_PAIR_IMMEDIATE, "LXI", 10, 3,
-                                   INSTR_OP_REG_PAIR_SP_AND_OP_16);
-            break;
-        case 0x32:
-            instr = populate_instr(INSTR_STORE_ACCUMULATOR_DIRECT, "STA", 13,
-                                   3, INSTR_OP_16);
-            break;
-        case 0x33:
-            instr = populate_instr(INSTR_INCREMENT_REG_PAIR, "INX", 5, 1,
-                                   INSTR_OP_REG_PAIR_SP);
-            break;
-        case 0x34:
-            instr = populate_instr(INSTR_INCREMENT_REG, "INR", 10, 1,
-                                   INSTR_OP_MEM_REF);
-            break;
-        case 0x35:
-            instr = populate_instr(INSTR_DECREMENT_REG, "DCR", 10, 1,
-                                   INSTR_OP_MEM_REF);
-            break;
-        case 0x36:
-            instr = populate_instr(INSTR_MOVE_IMMEDIATE, "MVI", 10, 2,
-                                   INSTR_OP_MEM_REF_AND_OP_8);
-            break;
-        case 0x37:
-            instr = populate_instr(INSTR_SET_CARRY, "STC", 4, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0x38:
-            instr = populate_instr(INSTR_NOP, "NOP", 4, 1, INSTR_OP_NONE);
-            break;
-        case 0x39:
-            instr = populate_instr(INSTR_DOUBLE_ADD, "DAD", 10, 1,
-                                   INSTR_OP_REG_PAIR_SP);
-            break;
-        case 0x3a:
-            instr = populate_instr(INSTR_LOAD_ACCUMULATOR_DIRECT, "LDA", 13,
-                                   3, INSTR_OP_16);
-            break;
-        case 0x3b:
-            instr = populate_instr(INSTR_DECREMENT_REG_PAIR, "DCX", 5, 1,
-                                   INSTR_OP_REG_PAIR_SP);
-            break;
-        case 0x3c:
-            instr = populate_instr(INSTR_INCREMENT_REG, "INR", 5, 1,
-                                   INSTR_OP_REG_A);
-            break;
-        case 0x3d:
-            instr = populate_instr(INSTR_DECREMENT_REG, "DCR", 5, 1,
-                                   INSTR_OP_REG_A);
-            break;
-        case 0x3e:
-            instr = populate_instr(INSTR_MOVE_IMMEDIATE, "MVI", 7, 2,
-                                   INSTR_OP_REG_A_AND_OP_8);
-            break;
-        case 0x3f:
-            instr = populate_instr(INSTR_COMPLEMENT_CARRY, "CMC", 4, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0x40:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x41:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x42:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x43:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x44:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x45:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x46:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x47:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x48:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x49:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x4a:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x4b:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x4c:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x4d:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x4e:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x4f:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x50:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x51:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x52:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x53:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x54:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x55:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x56:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x57:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x58:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x59:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x5a:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x5b:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x5c:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x5d:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x5e:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x5f:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x60:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x61:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x62:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x63:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x64:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x65:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x66:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x67:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x68:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x69:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x6a:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x6b:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x6c:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x6d:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x6e:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x6f:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x70:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x71:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x72:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x73:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x74:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x75:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x76:
-            instr = populate_instr(INSTR_HALT, "HLT", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x77:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x78:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x79:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x7a:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x7b:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x7c:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x7d:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x7e:
-            instr = populate_instr(INSTR_MOVE, "MOV", 7, 1, INSTR_OP_NONE);
-            break;
-        case 0x7f:
-            instr = populate_instr(INSTR_MOVE, "MOV", 5, 1, INSTR_OP_NONE);
-            break;
-        case 0x80:
-            instr = populate_instr(INSTR_ADD_REG, "ADD", 4, 1, INSTR_OP_REG_B);
-            break;
-        case 0x81:
-            instr = populate_instr(INSTR_ADD_REG, "ADD", 4, 1, INSTR_OP_REG_C);
-            break;
-        case 0x82:
-            instr = populate_instr(INSTR_ADD_REG, "ADD", 4, 1, INSTR_OP_REG_D);
-            break;
-        case 0x83:
-            instr = populate_instr(INSTR_ADD_REG, "ADD", 4, 1, INSTR_OP_REG_E);
-            break;
-        case 0x84:
-            instr = populate_instr(INSTR_ADD_REG, "ADD", 4, 1, INSTR_OP_REG_H);
-            break;
-        case 0x85:
-            instr = populate_instr(INSTR_ADD_REG, "ADD", 4, 1, INSTR_OP_REG_L);
-            break;
-        case 0x86:
-            instr = populate_instr(INSTR_ADD_REG, "ADD", 7, 1,
-                                   INSTR_OP_MEM_REF);
-            break;
-        case 0x87:
-            instr = populate_instr(INSTR_ADD_REG, "ADD", 4, 1, INSTR_OP_REG_A);
-            break;
-        case 0x88:
-            instr = populate_instr(INSTR_ADD_REG_WITH_CARRY, "ADC", 4, 1,
-                                   INSTR_OP_REG_B);
-            break;
-        case 0x89:
-            instr = populate_instr(INSTR_ADD_REG_WITH_CARRY, "ADC", 4, 1,
-                                   INSTR_OP_REG_C);
-            break;
-        case 0x8a:
-            instr = populate_instr(INSTR_ADD_REG_WITH_CARRY, "ADC", 4, 1,
-                                   INSTR_OP_REG_D);
-            break;
-        case 0x8b:
-            instr = populate_instr(INSTR_ADD_REG_WITH_CARRY, "ADC", 4, 1,
-                                   INSTR_OP_REG_E);
-            break;
-        case 0x8c:
-            instr = populate_instr(INSTR_ADD_REG_WITH_CARRY, "ADC", 4, 1,
-                                   INSTR_OP_REG_H);
-            break;
-        case 0x8d:
-            instr = populate_instr(INSTR_ADD_REG_WITH_CARRY, "ADC", 4, 1,
-                                   INSTR_OP_REG_L);
-            break;
-        case 0x8e:
-            instr = populate_instr(INSTR_ADD_REG_WITH_CARRY, "ADC", 7, 1,
-                                   INSTR_OP_MEM_REF);
-            break;
-        case 0x8f:
-            instr = populate_instr(INSTR_ADD_REG_WITH_CARRY, "ADC", 4, 1,
-                                   INSTR_OP_REG_A);
-            break;
-        case 0x90:
-            instr = populate_instr(INSTR_SUBTRACT_REG, "SUB", 4, 1,
-                                   INSTR_OP_REG_B);
-            break;
-        case 0x91:
-            instr = populate_instr(INSTR_SUBTRACT_REG, "SUB", 4, 1,
-                                   INSTR_OP_REG_C);
-            break;
-        case 0x92:
-            instr = populate_instr(INSTR_SUBTRACT_REG, "SUB", 4, 1,
-                                   INSTR_OP_REG_D);
-            break;
-        case 0x93:
-            instr = populate_instr(INSTR_SUBTRACT_REG, "SUB", 4, 1,
-                                   INSTR_OP_REG_E);
-            break;
-        case 0x94:
-            instr = populate_instr(INSTR_SUBTRACT_REG, "SUB", 4, 1,
-                                   INSTR_OP_REG_H);
-            break;
-        case 0x95:
-            instr = populate_instr(INSTR_SUBTRACT_REG, "SUB", 4, 1,
-                                   INSTR_OP_REG_L);
-            break;
-        case 0x96:
-            instr = populate_instr(INSTR_SUBTRACT_REG, "SUB", 7, 1,
-                                   INSTR_OP_MEM_REF);
-            break;
-        case 0x97:
-            instr = populate_instr(INSTR_SUBTRACT_REG, "SUB", 4, 1,
-                                   INSTR_OP_REG_A);
-            break;
-        case 0x98:
-            instr = populate_instr(INSTR_SUBTRACT_REG_WITH_BORROW, "SBB", 4, 1,
-                                   INSTR_OP_REG_B);
-            break;
-        case 0x99:
-            instr = populate_instr(INSTR_SUBTRACT_REG_WITH_BORROW, "SBB", 4, 1,
-                                   INSTR_OP_REG_C);
-            break;
-        case 0x9a:
-            instr = populate_instr(INSTR_SUBTRACT_REG_WITH_BORROW, "SBB", 4, 1,
-                                   INSTR_OP_REG_D);
-            break;
-        case 0x9b:
-            instr = populate_instr(INSTR_SUBTRACT_REG_WITH_BORROW, "SBB", 4, 1,
-                                   INSTR_OP_REG_E);
-            break;
-        case 0x9c:
-            instr = populate_instr(INSTR_SUBTRACT_REG_WITH_BORROW, "SBB", 4, 1,
-                                   INSTR_OP_REG_H);
-            break;
-        case 0x9d:
-            instr = populate_instr(INSTR_SUBTRACT_REG_WITH_BORROW, "SBB", 4, 1,
-                                   INSTR_OP_REG_L);
-            break;
-        case 0x9e:
-            instr = populate_instr(INSTR_SUBTRACT_REG_WITH_BORROW, "SBB", 7, 1,
-                                   INSTR_OP_MEM_REF);
-            break;
-        case 0x9f:
-            instr = populate_instr(INSTR_SUBTRACT_REG_WITH_BORROW, "SBB", 4, 1,
-                                   INSTR_OP_REG_A);
-            break;
-        case 0xa0:
-            instr = populate_instr(INSTR_AND_REG, "ANA", 4, 1,
-                                   INSTR_OP_REG_B);
-            break;
-        case 0xa1:
-            instr = populate_instr(INSTR_AND_REG, "ANA", 4, 1,
-                                   INSTR_OP_REG_C);
-            break;
-        case 0xa2:
-            instr = populate_instr(INSTR_AND_REG, "ANA", 4, 1,
-                                   INSTR_OP_REG_D);
-            break;
-        case 0xa3:
-            instr = populate_instr(INSTR_AND_REG, "ANA", 4, 1,
-                                   INSTR_OP_REG_E);
-            break;
-        case 0xa4:
-            instr = populate_instr(INSTR_AND_REG, "ANA", 4, 1,
-                                   INSTR_OP_REG_H);
-            break;
-        case 0xa5:
-            instr = populate_instr(INSTR_AND_REG, "ANA", 4, 1,
-                                   INSTR_OP_REG_L);
-            break;
-        case 0xa6:
-            instr = populate_instr(INSTR_AND_REG, "ANA", 7, 1,
-                                   INSTR_OP_MEM_REF);
-            break;
-        case 0xa7:
-            instr = populate_instr(INSTR_AND_REG, "ANA", 4, 1,
-                                   INSTR_OP_REG_A);
-            break;
-        case 0xa8:
-            instr = populate_instr(INSTR_XOR_REG, "XRA", 4, 1,
-                                   INSTR_OP_REG_B);
-            break;
-        case 0xa9:
-            instr = populate_instr(INSTR_XOR_REG, "XRA", 4, 1,
-                                   INSTR_OP_REG_C);
-            break;
-        case 0xaa:
-            instr = populate_instr(INSTR_XOR_REG, "XRA", 4, 1,
-                                   INSTR_OP_REG_D);
-            break;
-        case 0xab:
-            instr = populate_instr(INSTR_XOR_REG, "XRA", 4, 1,
-                                   INSTR_OP_REG_E);
-            break;
-        case 0xac:
-            instr = populate_instr(INSTR_XOR_REG, "XRA", 4, 1,
-                                   INSTR_OP_REG_H);
-            break;
-        case 0xad:
-            instr = populate_instr(INSTR_XOR_REG, "XRA", 4, 1,
-                                   INSTR_OP_REG_L);
-            break;
-        case 0xae:
-            instr = populate_instr(INSTR_XOR_REG, "XRA", 7, 1,
-                                   INSTR_OP_MEM_REF);
-            break;
-        case 0xaf:
-            instr = populate_instr(INSTR_XOR_REG, "XRA", 4, 1,
-                                   INSTR_OP_REG_A);
-            break;
-        case 0xb0:
-            instr = populate_instr(INSTR_OR_REG, "ORA", 4, 1,
-                                   INSTR_OP_REG_B);
-            break;
-        case 0xb1:
-            instr = populate_instr(INSTR_OR_REG, "ORA", 4, 1,
-                                   INSTR_OP_REG_C);
-            break;
-        case 0xb2:
-            instr = populate_instr(INSTR_OR_REG, "ORA", 4, 1,
-                                   INSTR_OP_REG_D);
-            break;
-        case 0xb3:
-            instr = populate_instr(INSTR_OR_REG, "ORA", 4, 1,
-                                   INSTR_OP_REG_E);
-            break;
-        case 0xb4:
-            instr = populate_instr(INSTR_OR_REG, "ORA", 4, 1,
-                                   INSTR_OP_REG_H);
-            break;
-        case 0xb5:
-            instr = populate_instr(INSTR_OR_REG, "ORA", 4, 1,
-                                   INSTR_OP_REG_L);
-            break;
-        case 0xb6:
-            instr = populate_instr(INSTR_OR_REG, "ORA", 7, 1,
-                                   INSTR_OP_MEM_REF);
-            break;
-        case 0xb7:
-            instr = populate_instr(INSTR_OR_REG, "ORA", 4, 1,
-                                   INSTR_OP_REG_A);
-            break;
-        case 0xb8:
-            instr = populate_instr(INSTR_COMPARE_REG, "CMP", 4, 1,
-                                   INSTR_OP_REG_B);
-            break;
-        case 0xb9:
-            instr = populate_instr(INSTR_COMPARE_REG, "CMP", 4, 1,
-                                   INSTR_OP_REG_C);
-            break;
-        case 0xba:
-            instr = populate_instr(INSTR_COMPARE_REG, "CMP", 4, 1,
-                                   INSTR_OP_REG_D);
-            break;
-        case 0xbb:
-            instr = populate_instr(INSTR_COMPARE_REG, "CMP", 4, 1,
-                                   INSTR_OP_REG_E);
-            break;
-        case 0xbc:
-            instr = populate_instr(INSTR_COMPARE_REG, "CMP", 4, 1,
-                                   INSTR_OP_REG_H);
-            break;
-        case 0xbd:
-            instr = populate_instr(INSTR_COMPARE_REG, "CMP", 4, 1,
-                                   INSTR_OP_REG_L);
-            break;
-        case 0xbe:
-            instr = populate_instr(INSTR_COMPARE_REG, "CMP", 7, 1,
-                                   INSTR_OP_MEM_REF);
-            break;
-        case 0xbf:
-            instr = populate_instr(INSTR_COMPARE_REG, "CMP", 4, 1,
-                                   INSTR_OP_REG_A);
-            break;
-        case 0xc0:
-            instr = populate_instr(INSTR_RETURN_IF_NOT_ZERO, "RNZ", 5, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xc1:
-            instr = populate_instr(INSTR_POP, "POP", 10, 1,
-                                   INSTR_OP_REG_PAIR_B);
-            break;
-        case 0xc2:
-            instr = populate_instr(INSTR_JUMP_IF_NOT_ZERO, "JNZ", 10, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xc3:
-            instr = populate_instr(INSTR_JUMP, "JMP", 10, 3, INSTR_OP_16);
-            break;
-        case 0xc4:
-            instr = populate_instr(INSTR_CALL_IF_NOT_ZERO, "CNZ", 11, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xc5:
-            instr = populate_instr(INSTR_PUSH, "PUSH", 11, 1,
-                                   INSTR_OP_REG_PAIR_B);
-            break;
-        case 0xc6:
-            instr = populate_instr(INSTR_ADD_IMMEDIATE, "ADI", 7, 2,
-                                   INSTR_OP_SINGLE_8);
-            break;
-        case 0xc7:
-            instr = populate_instr(INSTR_RESTART_0, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xc8:
-            instr = populate_instr(INSTR_RETURN_IF_ZERO, "RZ", 5, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xc9:
-            instr = populate_instr(INSTR_RETURN, "RET", 10, 1, INSTR_OP_NONE);
-            break;
-        case 0xca:
-            instr = populate_instr(INSTR_JUMP_IF_ZERO, "JZ", 10, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xcb:
-            instr = populate_instr(INSTR_JUMP, "JMP", 10, 3, INSTR_OP_16);
-            break;
-            break;
-        case 0xcc:
-            instr = populate_instr(INSTR_CALL_IF_ZERO, "CZ", 11, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xcd:
-            instr = populate_instr(INSTR_CALL, "CALL", 17, 3, INSTR_OP_16);
-            break;
-        case 0xce:
-            instr = populate_instr(INSTR_ADD_IMMEDIATE_WITH_CARRY, "ACI", 7, 2,
-                                   INSTR_OP_SINGLE_8);
-            break;
-        case 0xcf:
-            instr = populate_instr(INSTR_RESTART_1, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xd0:
-            instr = populate_instr(INSTR_RETURN_IF_NO_CARRY, "RNC", 5, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xd1:
-            instr = populate_instr(INSTR_POP, "POP", 10, 1,
-                                   INSTR_OP_REG_PAIR_D);
-            break;
-        case 0xd2:
-            instr = populate_instr(INSTR_JUMP_IF_NO_CARRY, "JNC", 10, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xd3:
-            instr = populate_instr(INSTR_OUTPUT, "OUT", 10, 2,
-                                   INSTR_OP_SINGLE_8);
-            break;
-        case 0xd4:
-            instr = populate_instr(INSTR_CALL_IF_NO_CARRY, "CNC", 11, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xd5:
-            instr = populate_instr(INSTR_PUSH, "PUSH", 11, 1,
-                                   INSTR_OP_REG_PAIR_D);
-            break;
-        case 0xd6:
-            instr = populate_instr(INSTR_SUBTRACT_IMMEDIATE, "SUI", 7, 2,
-                                   INSTR_OP_SINGLE_8);
-            break;
-        case 0xd7:
-            instr = populate_instr(INSTR_RESTART_2, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xd8:
-            instr = populate_instr(INSTR_RETURN_IF_CARRY, "RC", 5, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xd9:
-            instr = populate_instr(INSTR_RETURN, "RET", 10, 1, INSTR_OP_NONE);
-            break;
-        case 0xda:
-            instr = populate_instr(INSTR_JUMP_IF_CARRY, "JC", 10, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xdb:
-            instr = populate_instr(INSTR_INPUT, "IN", 10, 2,
-                                   INSTR_OP_SINGLE_8);
-            break;
-        case 0xdc:
-            instr = populate_instr(INSTR_CALL_IF_CARRY, "CC", 11, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xdd:
-            instr = populate_instr(INSTR_CALL, "CALL", 17, 3, INSTR_OP_16);
-            break;
-        case 0xde:
-            instr = populate_instr(INSTR_SUBTRACT_IMMEDIATE_WITH_BORROW, "SBI",
-                                   7, 2, INSTR_OP_SINGLE_8);
-            break;
-        case 0xdf:
-            instr = populate_instr(INSTR_RESTART_3, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xe0:
-            instr = populate_instr(INSTR_RETURN_IF_PARITY_ODD, "RPO", 5, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xe1:
-            instr = populate_instr(INSTR_POP, "POP", 10, 1,
-                                   INSTR_OP_REG_PAIR_H);
-            break;
-        case 0xe2:
-            instr = populate_instr(INSTR_JUMP_IF_PARITY_ODD, "JPO", 10, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xe3:
-            instr = populate_instr(INSTR_EXCHANGE_STACK, "XTHL", 18, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xe4:
-            instr = populate_instr(INSTR_CALL_IF_PARITY_ODD, "CPO", 11, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xe5:
-            instr = populate_instr(INSTR_PUSH, "PUSH", 11, 1,
-                                   INSTR_OP_REG_PAIR_H);
-            break;
-        case 0xe6:
-            instr = populate_instr(INSTR_AND_IMMEDIATE, "ANI", 7, 2,
-                                   INSTR_OP_SINGLE_8);
-            break;
-        case 0xe7:
-            instr = populate_instr(INSTR_RESTART_4, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xe8:
-            instr = populate_instr(INSTR_RETURN_IF_PARITY_EVEN, "RPE", 5, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xe9:
-            instr = populate_instr(INSTR_LOAD_PROGRAM_COUNTER, "PCHL", 5, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xea:
-            instr = populate_instr(INSTR_JUMP_IF_PARITY_EVEN, "JPE", 10, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xeb:
-            instr = populate_instr(INSTR_EXCHANGE_REGS, "XCHG", 5, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xec:
-            instr = populate_instr(INSTR_CALL_IF_PARITY_EVEN, "CPE", 11, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xed:
-            instr = populate_instr(INSTR_CALL, "CALL", 17, 3, INSTR_OP_16);
-            break;
-        case 0xee:
-            instr = populate_instr(INSTR_XOR_IMMEDIATE, "XRI", 7, 2,
-                                   INSTR_OP_SINGLE_8);
-            break;
-        case 0xef:
-            instr = populate_instr(INSTR_RESTART_5, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xf0:
-            instr = populate_instr(INSTR_RETURN_IF_PLUS, "RP", 5, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xf1:
-            instr = populate_instr(INSTR_POP, "POP", 10, 1,
-                                   INSTR_OP_REG_PAIR_PSW);
-            break;
-        case 0xf2:
-            instr = populate_instr(INSTR_JUMP_IF_PLUS, "JP", 10, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xf3:
-            instr = populate_instr(INSTR_DISABLE_INTERRUPT, "DI", 4, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xf4:
-            instr = populate_instr(INSTR_CALL_IF_PLUS, "CP", 11, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xf5:
-            instr = populate_instr(INSTR_PUSH, "PUSH", 11, 1,
-                                   INSTR_OP_REG_PAIR_PSW);
-            break;
-        case 0xf6:
-            instr = populate_instr(INSTR_OR_IMMEDIATE, "ORI", 7, 2,
-                                   INSTR_OP_SINGLE_8);
-            break;
-        case 0xf7:
-            instr = populate_instr(INSTR_RESTART_6, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xf8:
-            instr = populate_instr(INSTR_RETURN_IF_MINUS, "RPE", 5, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xf9:
-            instr = populate_instr(INSTR_LOAD_SP_FROM_HL, "SPHL", 5, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xfa:
-            instr = populate_instr(INSTR_JUMP_IF_MINUS, "JM", 10, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xfb:
-            instr = populate_instr(INSTR_ENABLE_INTERRUPT, "EI", 4, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case 0xfc:
-            instr = populate_instr(INSTR_CALL_IF_MINUS, "CM", 11, 3,
-                                   INSTR_OP_16);
-            break;
-        case 0xfd:
-            instr = populate_instr(INSTR_CALL, "CALL", 17, 3, INSTR_OP_16);
-            break;
-        case 0xfe:
-            instr = populate_instr(INSTR_COMPARE_IMMEDIATE, "CPI", 7, 2,
-                                   INSTR_OP_SINGLE_8);
-            break;
-        case 0xff:
-            instr = populate_instr(INSTR_RESTART_7, "RST", 11, 1,
-                                   INSTR_OP_NONE);
+    for (int i = 0; i < watchpoint_count; i++) {
+        for (int page = watchpoints[i].start >> 8;
+             page <= watchpoints[i].end >> 8; page++) {
+            page_watch_flags[page] |= watchpoints[i].access;
+        }
+    }
+}
+
+// Watches data reads and/or writes of the inclusive range start-end.
+// Instruction fetches are not data reads. Builds with NO_CPU_HOOKS
+// never check for watchpoints, so adding one fails.
+bool add_watchpoint(uint16_t start, uint16_t end, uint8_t access,
+                    WatchHook hook) {
+#ifdef NO_CPU_HOOKS
+    (void)start;
+    (void)end;
+    (void)access;
+    (void)hook;
+    return false;
+#else
+    if (watchpoint_count == MAX_WATCHPOINTS || start > end) {
+        return false;
+    }
+
+    watchpoints[watchpoint_count].start = start;
+    watchpoints[watchpoint_count].end = end;
+    watchpoints[watchpoint_count].access = access;
+    watchpoints[watchpoint_count].hook = hook;
+    watchpoint_count++;
+    update_page_watch_flags();
+    return true;
+#endif
+}
+
+void remove_watchpoint(uint16_t start, uint16_t end, WatchHook hook) {
+    for (int i = 0; i < watchpoint_count; i++) {
+        if (watchpoints[i].start == start && watchpoints[i].end == end &&
+            watchpoints[i].hook == hook) {
+            watchpoints[i] = watchpoints[watchpoint_count - 1];
+            watchpoint_count--;
             break;
+        }
+    }
+    update_page_watch_flags();
+}
+
+void clear_watchpoints() {
+    watchpoint_count = 0;
+    update_page_watch_flags();
+}
+
+#ifndef NO_CPU_HOOKS
+// Slow path, only taken on tagged pages. Writes are reported after
+// the new value has been stored.
+static void check_watchpoints(uint16_t address, uint8_t access) {
+    for (int i = 0; i < watchpoint_count; i++) {
+        if ((watchpoints[i].access & access) &&
+            address >= watchpoints[i].start &&
+            address <= watchpoints[i].end) {
+            watchpoints[i].hook(address, memory[address],
+                                access == WATCH_WRITE);
+        }
+    }
+}
+#endif
+
+static inline uint8_t read_mem(uint16_t address) {
+#ifndef NO_CPU_HOOKS
+    if (page_watch_flags[address >> 8] & WATCH_READ) {
+        check_watchpoints(address, WATCH_READ);
     }
+#endif
+    return memory[address];
+}
 
-    // Reached end of possible instructions
-    if (instr.cycle_count == 999) {
-        printf("Error: Unrecognized opcode: 0x%02x\n", instr.opcode);
-        exit(1);
+static inline void write_mem(uint16_t address, uint8_t value) {
+    memory[address] = value;
+    invalidate_decoded(address);
+#ifndef NO_CPU_HOOKS
+    if (page_watch_flags[address >> 8] & WATCH_WRITE) {
+        check_watchpoints(address, WATCH_WRITE);
     }
+#endif
+}
 
+// Indexed by opcode, the operand is filled in when decoding
+static const Instr decode_table[256] = {
+#define X(opcode, type, dst, src, mnemonic, registers, cycles, bytes) \
+    [opcode] = { INSTR_##type, opcode, cycles, bytes, 0 },
+    FOR_EACH_OPCODE(X)
+#undef X
+};
+
+// The RST the interrupting device puts on the bus, run in place of the
+// instruction at pc. With no bytes to skip it pushes pc unchanged.
+static Instr accept_interrupt() {
+    Instr instr = decode_table[pending_interrupt_opcode];
+
+    instr.byte_count = 0;
+    is_interrupt_pending = false;
+    is_interruptible = false;
+    is_halted = false;
     return instr;
 }
 
-uint8_t *get_reg_op(InstrOpType op_type) {
-    switch (op_type) {
-        case INSTR_OP_REG_B:
-        case INSTR_OP_REG_B_AND_OP_8:
-            return &reg_B;
-            break;
-        case INSTR_OP_REG_C:
-        case INSTR_OP_REG_C_AND_OP_8:
-            return &reg_C;
-            break;
-        case INSTR_OP_REG_D:
-        case INSTR_OP_REG_D_AND_OP_8:
-            return &reg_D;
-            break;
-        case INSTR_OP_REG_E:
-        case INSTR_OP_REG_E_AND_OP_8:
-            return &reg_E;
-            break;
-        case INSTR_OP_REG_H:
-        case INSTR_OP_REG_H_AND_OP_8:
-            return &reg_H;
-            break;
-        case INSTR_OP_REG_L:
-        case INSTR_OP_REG_L_AND_OP_8:
-            return &reg_L;
-            break;
-        case INSTR_OP_REG_A:
-        case INSTR_OP_REG_A_AND_OP_8:
-            return &reg_A;
-            break;
-        case INSTR_OP_MEM_REF:
-        case INSTR_OP_MEM_REF_AND_OP_8:
-            return &memory[(reg_H << 8) | reg_L];
+Instr fetch_instr() {
+    if (is_interrupt_pending && is_interruptible && !is_enable_delayed) {
+        return accept_interrupt();
+    }
+
+#ifndef NO_CPU_HOOKS
+    if (pc_hook_blocks[pc >> 11] & (1 << ((pc >> 8) & 0x7))) {
+        run_pc_hooks();
+    }
+#endif
+
+    Instr instr = decode_cache[pc];
+
+    if (instr.byte_count == 0) {
+        instr = decode_table[memory[pc]];
+        if (instr.byte_count == 2) {
+            instr.operand = memory[(uint16_t)(pc + 1)];
+        } else if (instr.byte_count == 3) {
+            instr.operand = memory[(uint16_t)(pc + 1)] |
+                            (memory[(uint16_t)(pc + 2)] << 8);
+        }
+        decode_cache[pc] = instr;
+    }
+
+#ifdef CPU_OPCODE_STATS
+    count_opcode(instr.opcode);
+#endif
+
+    return instr;
+}
+
+static inline bool has_pc_hook(uint16_t address) {
+#ifndef NO_CPU_HOOKS
+    return pc_hook_bitmap[address >> 3] & (1 << (address & 0x7));
+#else
+    (void)address;
+    return false;
+#endif
+}
+
+// Like fetch_instr, but when the instruction at pc starts one of the
+// hot sequences below, returns a single instruction that runs the whole
+// sequence with the same cycles and flags. A sequence is only fused
+// when that can't be observed: every instruction but the last has to
+// start inside `cycles_left` so a due interrupt still lands where it
+// would have, no interrupt may be pending, no PC hook may be armed
+// inside it, and nothing may be recording instructions one by one.
+Instr fetch_fused_instr(int cycles_left) {
+    Instr instr = fetch_instr();
+
+#if defined(CPU_PROFILE) || defined(CPU_OPCODE_STATS)
+    (void)cycles_left;
+#else
+    uint16_t next = pc + 1;
+
+    if (trace_ring != NULL || is_interrupt_pending) {
+        return instr;
+    }
+
+    switch (instr.opcode) {
+        // MOV A,M; INX H
+        case 0x7e:
+            if (memory[next] == 0x23 && cycles_left > 7 &&
+                !has_pc_hook(next)) {
+                instr.type = INSTR_FUSED_LOAD_A_INX_H;
+                instr.cycle_count = 12;
+                instr.byte_count = 2;
+            }
             break;
-        default:
-            printf("Error: Operand type not recognized\n");
-            exit(0);
+        // DCR B; JNZ and DCR C; JNZ
+        case 0x05:
+        case 0x0d:
+            if (memory[next] == 0xc2 && cycles_left > 5 &&
+                !has_pc_hook(next)) {
+                instr.type = INSTR_FUSED_DCR_JNZ;
+                instr.cycle_count = 15;
+                instr.byte_count = 4;
+                instr.operand = memory[(uint16_t)(next + 1)] |
+                                (memory[(uint16_t)(next + 2)] << 8);
+            }
+            break;
+        // LDAX D; MOV M,A; INX H; INX D, unless the store would
+        // overwrite one of the INX instructions
+        case 0x1a: {
+            uint16_t dest = ((uint16_t)reg_H << 8) | reg_L;
+            if (memory[next] == 0x77 &&
+                memory[(uint16_t)(next + 1)] == 0x23 &&
+                memory[(uint16_t)(next + 2)] == 0x13 &&
+                cycles_left > 19 &&
+                dest != (uint16_t)(next + 1) &&
+                dest != (uint16_t)(next + 2) &&
+                !has_pc_hook(next) &&
+                !has_pc_hook(next + 1) &&
+                !has_pc_hook(next + 2)) {
+                instr.type = INSTR_FUSED_COPY_DE_TO_HL;
+                instr.cycle_count = 24;
+                instr.byte_count = 4;
+            }
             break;
+        }
     }
+#endif
+
+    return instr;
 }
 
 bool is_parity_even(uint8_t val) {
@@ -1204,12 +494,6 @@ void calculate_non_carry_flags(uint8_t val) {
     flag_parity = is_parity_even(val);
 }
 
-uint16_t get_swapped_bytes(uint16_t val) {
-    uint16_t swapped = ((uint16_t)val & 0xff00) >> 8;
-    swapped = swapped | ((val & 0xff) << 8);
-    return swapped;
-}
-
 uint8_t get_flag_reg() {
     uint8_t val;
     val = flag_sign << 7;
@@ -1233,657 +517,399 @@ void set_flag_reg(uint8_t val) {
 
 void push(uint16_t val) {
     sp = (sp - 2) & 0xffff;
-    memory[sp + 1] = (val >> 8);
-    memory[sp] = (val & 0xff);
+    write_mem(sp + 1, val >> 8);
+    write_mem(sp, val & 0xff);
 }
 
 uint16_t pop() {
     uint16_t val;
-    val = ((uint16_t)memory[sp + 1] << 8);
-    val |= memory[sp];
+    val = ((uint16_t)read_mem(sp + 1) << 8);
+    val |= read_mem(sp);
     sp = sp + 2;
     return val;
 }
 
 void call_sub(uint16_t address) {
+#ifdef CPU_PROFILE
+    profile_call(address, pc);
+#endif
     push(pc);
     pc = address;
 }
 
 void return_sub() {
     pc = pop();
+#ifdef CPU_PROFILE
+    profile_return(pc);
+#endif
 }
 
-int exec_instr(Instr instr) {
-    if (is_halted) {
-        return 0;
+static void record_trace(Instr *instr) {
+    TraceRecord record;
+
+    record.cycle = cycle_counter;
+    record.pc = pc;
+    record.opcode = instr->opcode;
+    record.operand_1 = memory[(uint16_t)(pc + 1)];
+    record.operand_2 = memory[(uint16_t)(pc + 2)];
+    record.reg_A = reg_A;
+    record.flags = get_flag_reg();
+    record.padding = 0;
+
+    push_trace_record(trace_ring, &record);
+}
+
+// Register operands as named in opcodes.h. M is the byte at (HL) and
+// goes through read_mem/write_mem like any other memory access.
+#define GET_B reg_B
+#define GET_C reg_C
+#define GET_D reg_D
+#define GET_E reg_E
+#define GET_H reg_H
+#define GET_L reg_L
+#define GET_A reg_A
+#define GET_M read_mem(GET_HL)
+#define GET_BC (((uint16_t)reg_B << 8) | reg_C)
+#define GET_DE (((uint16_t)reg_D << 8) | reg_E)
+#define GET_HL (((uint16_t)reg_H << 8) | reg_L)
+#define GET_SP sp
+#define GET_PSW (((uint16_t)reg_A << 8) | get_flag_reg())
+
+#define SET_B(val) (reg_B = (val))
+#define SET_C(val) (reg_C = (val))
+#define SET_D(val) (reg_D = (val))
+#define SET_E(val) (reg_E = (val))
+#define SET_H(val) (reg_H = (val))
+#define SET_L(val) (reg_L = (val))
+#define SET_A(val) (reg_A = (val))
+#define SET_M(val) write_mem(GET_HL, (val))
+#define SET_BC(val) set_reg_pair(&reg_B, &reg_C, (val))
+#define SET_DE(val) set_reg_pair(&reg_D, &reg_E, (val))
+#define SET_HL(val) set_reg_pair(&reg_H, &reg_L, (val))
+#define SET_SP(val) (sp = (val))
+#define SET_PSW(val) set_reg_pair(&reg_A, NULL, (val))
+
+// PSW passes NULL for the flags
+static inline void set_reg_pair(uint8_t *high, uint8_t *low, uint16_t val) {
+    *high = val >> 8;
+    if (low != NULL) {
+        *low = val & 0xff;
+    } else {
+        set_flag_reg(val & 0xff);
     }
+}
 
-    pc += instr.byte_count;
+static inline uint8_t increment(uint8_t val) {
+    val++;
+    calculate_non_carry_flags(val);
+    flag_aux_carry = (val & 0x0f) == 0;
+    return val;
+}
 
-    switch (instr.type) {
-        case INSTR_NOP:
-            break;
-        case INSTR_HALT:
-            is_halted = true;
-            break;
-        case INSTR_DISABLE_INTERRUPT:
-            is_interruptible = false;
-            break;
-        case INSTR_ENABLE_INTERRUPT:
-            is_interruptible = true;
-            break;
-        case INSTR_OUTPUT:
-            output_ports[instr.operand_8_1] = reg_A;
-            break;
-        case INSTR_INPUT:
-            reg_A = input_ports[instr.operand_8_1];
-            break;
-        case INSTR_DOUBLE_ADD:
-            if (instr.op_type == INSTR_OP_REG_PAIR_B) {
-                uint32_t op1 = ((uint32_t)reg_B << 8) | reg_C;
-                uint32_t op2 = ((uint32_t)reg_H << 8) | reg_L;
-                uint32_t sum = op1 + op2;
-                flag_carry = sum >> 16;
-                reg_H = (sum >> 8) & 0xff;
-                reg_L = sum & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_D) {
-                uint32_t op1 = ((uint32_t)reg_D << 8) | reg_E;
-                uint32_t op2 = ((uint32_t)reg_H << 8) | reg_L;
-                uint32_t sum = op1 + op2;
-                flag_carry = sum >> 16;
-                reg_H = (sum >> 8) & 0xff;
-                reg_L = sum & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_H) {
-                uint32_t op1 = ((uint32_t)reg_H << 8) | reg_L;
-                uint32_t op2 = ((uint32_t)reg_H << 8) | reg_L;
-                uint32_t sum = op1 + op2;
-                flag_carry = sum >> 16;
-                reg_H = (sum >> 8) & 0xff;
-                reg_L = sum & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_SP) {
-                uint32_t op1 = sp;
-                uint32_t op2 = ((uint32_t)reg_H << 8) | reg_L;
-                uint32_t sum = op1 + op2;
-                flag_carry = sum >> 16;
-                reg_H = (sum >> 8) & 0xff;
-                reg_L = sum & 0xff;
-            }
-            break;
-        case INSTR_INCREMENT_REG_PAIR: {
-            uint16_t val;
-            if (instr.op_type == INSTR_OP_REG_PAIR_B) {
-                val = ((uint16_t)reg_B << 8) | reg_C;
-                val++;
-                reg_B = val >> 8;
-                reg_C = val & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_D) {
-                val = ((uint16_t)reg_D << 8) | reg_E;
-                val++;
-                reg_D = val >> 8;
-                reg_E = val & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_H) {
-                val = ((uint16_t)reg_H << 8) | reg_L;
-                val++;
-                reg_H = val >> 8;
-                reg_L = val & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_SP) {
-                sp++;
-            }
-            break;
-        }
-        case INSTR_DECREMENT_REG_PAIR: {
-            uint16_t val;
-            if (instr.op_type == INSTR_OP_REG_PAIR_B) {
-                val = ((uint16_t)reg_B << 8) | reg_C;
-                val--;
-                reg_B = val >> 8;
-                reg_C = val & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_D) {
-                val = ((uint16_t)reg_D << 8) | reg_E;
-                val--;
-                reg_D = val >> 8;
-                reg_E = val & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_H) {
-                val = ((uint16_t)reg_H << 8) | reg_L;
-                val--;
-                reg_H = val >> 8;
-                reg_L = val & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_SP) {
-                sp--;
-            }
-            break;
-        }
-        case INSTR_POP:
-            if (instr.op_type == INSTR_OP_REG_PAIR_B) {
-                uint16_t val = pop();
-                reg_B = val >> 8;
-                reg_C = val & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_D) {
-                uint16_t val = pop();
-                reg_D = val >> 8;
-                reg_E = val & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_H) {
-                uint16_t val = pop();
-                reg_H = val >> 8;
-                reg_L = val & 0xff;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_PSW) {
-                uint16_t val = pop();
-                reg_A = val >> 8;
-                set_flag_reg(val & 0xff);
-            }
-            break;
-        case INSTR_PUSH:
-            if (instr.op_type == INSTR_OP_REG_PAIR_B) {
-                uint16_t val = ((uint16_t)reg_B << 8) | reg_C;
-                push(val);
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_D) {
-                uint16_t val = ((uint16_t)reg_D << 8) | reg_E;
-                push(val);
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_H) {
-                uint16_t val = ((uint16_t)reg_H << 8) | reg_L;
-                push(val);
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_PSW) {
-                uint16_t val = ((uint16_t)reg_A << 8) | get_flag_reg();
-                push(val);
-            }
-            break;
-        case INSTR_EXCHANGE_STACK: {
-            uint8_t temp;
-            temp = reg_H;
-            reg_H = memory[sp + 1];
-            memory[sp + 1] = temp;
-            temp = reg_L;
-            reg_L = memory[sp];
-            memory[sp] = temp;
-            break;
-        }
-        case INSTR_LOAD_SP_FROM_HL:
-            sp = ((uint16_t)reg_H << 8) | reg_L;
-            break;
-        case INSTR_EXCHANGE_REGS: {
-            uint8_t temp;
-            temp = reg_H;
-            reg_H = reg_D;
-            reg_D = temp;
-            temp = reg_L;
-            reg_L = reg_E;
-            reg_E = temp;
-            break;
-        }
-        case INSTR_LOAD_HL_DIRECT: {
-            uint16_t address = get_swapped_bytes(instr.operand_16);
-            reg_H = memory[address + 1];
-            reg_L = memory[address];
-            break;
-        }
-        case INSTR_STORE_HL_DIRECT: {
-            uint16_t address = get_swapped_bytes(instr.operand_16);
-            memory[address] = reg_L;
-            memory[address + 1] = reg_H;
-            break;
-        }
-        case INSTR_LOAD_REG_PAIR_IMMEDIATE:
-            if (instr.op_type == INSTR_OP_REG_PAIR_B_AND_OP_16) {
-                reg_B = instr.operand_16 & 0xff;
-                reg_C = instr.operand_16 >> 8;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_D_AND_OP_16) {
-                reg_D = instr.operand_16 & 0xff;
-                reg_E = instr.operand_16 >> 8;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_H_AND_OP_16) {
-                reg_H = instr.operand_16 & 0xff;
-                reg_L = instr.operand_16 >> 8;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_SP_AND_OP_16) {
-                sp = (instr.operand_16 & 0xff) << 8;
-                sp |= instr.operand_16 >> 8;
-            }
-            break;
-        case INSTR_STORE_ACCUMULATOR: {
-            if (instr.op_type == INSTR_OP_REG_PAIR_B) {
-                memory[((uint16_t)reg_B << 8) | reg_C] = reg_A;
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_D) {
-                memory[((uint16_t)reg_D << 8) | reg_E] = reg_A;
-            }
-            break;
-        }
-        case INSTR_LOAD_ACCUMULATOR: {
-            if (instr.op_type == INSTR_OP_REG_PAIR_B) {
-                uint16_t address = ((uint16_t)reg_B << 8) | reg_C;
-                reg_A = memory[address];
-            } else if (instr.op_type == INSTR_OP_REG_PAIR_D) {
-                uint16_t address = ((uint16_t)reg_D << 8) | reg_E;
-                reg_A = memory[address];
-            }
-            break;
-        }
-        case INSTR_STORE_ACCUMULATOR_DIRECT:
-            memory[get_swapped_bytes(instr.operand_16)] = reg_A;
-            break;
-        case INSTR_LOAD_ACCUMULATOR_DIRECT:
-            reg_A = memory[get_swapped_bytes(instr.operand_16)];
-            break;
-        case INSTR_MOVE_IMMEDIATE: {
-            uint8_t *op_ptr = get_reg_op(instr.op_type);
-            *op_ptr = instr.operand_8_1;
-            break;
-        }
-        case INSTR_MOVE: {
-            uint8_t *source_ptr = get_reg_op(instr.move_source);
-            uint8_t *dest_ptr = get_reg_op(instr.move_destination);
-            *dest_ptr = *source_ptr;
-            break;
-        }
-        case INSTR_INCREMENT_REG: {
-            uint8_t *op_ptr = get_reg_op(instr.op_type);
-            uint8_t val = *op_ptr + 1;
-            calculate_non_carry_flags(val);
-            flag_aux_carry = (val & 0x0f) == 0;
-            *op_ptr = val;
-            break;
-        }
-        case INSTR_DECREMENT_REG: {
-            uint8_t *op_ptr = get_reg_op(instr.op_type);
-            uint8_t val = *op_ptr - 1;
-            calculate_non_carry_flags(val);
-            flag_aux_carry = !((val & 0x0f) == 0x0f);
-            *op_ptr = val;
-            break;
-        }
-        case INSTR_ROTATE_ACCUMULATOR_LEFT:
-            flag_carry = reg_A & 0x80;
-            reg_A = reg_A << 1;
-            reg_A = reg_A | (flag_carry ? 0x01 : 0x00);
-            break;
-        case INSTR_ROTATE_ACCUMULATOR_RIGHT:
-            flag_carry = reg_A & 0x01;
-            reg_A = reg_A >> 1;
-            reg_A = reg_A | (flag_carry ? 0x80 : 0x00);
-            break;
-        case INSTR_ROTATE_ACCUMULATOR_LEFT_CARRY: {
-            bool old_carry = flag_carry;
-            flag_carry = reg_A & 0x80;
-            reg_A = reg_A << 1;
-            reg_A = reg_A | (old_carry ? 0x01 : 0x00);
-            break;
-        }
-        case INSTR_ROTATE_ACCUMULATOR_RIGHT_CARRY: {
-            bool old_carry = flag_carry;
-            flag_carry = reg_A & 0x01;
-            reg_A = reg_A >> 1;
-            reg_A = reg_A | (old_carry ? 0x80 : 0x00);
-            break;
-        }
-        case INSTR_DECIMAL_ADJUST_ACCUMULATOR: {
-            bool temp_flag_carry = flag_carry;
-            uint8_t low = reg_A & 0x0f;
-            uint8_t high = reg_A >> 4;
-
-            if ((low > 9) || flag_aux_carry) {
-                reg_A += 0x06;
-                flag_aux_carry = (low + 6) > 0x0f;
-            }
+static inline uint8_t decrement(uint8_t val) {
+    val--;
+    calculate_non_carry_flags(val);
+    flag_aux_carry = !((val & 0x0f) == 0x0f);
+    return val;
+}
 
-            if ((high > 9) || flag_carry || (high == 9 && low > 9)) {
-                reg_A += 0x60;
-                temp_flag_carry = true;
-            }
+static inline void double_add(uint16_t val) {
+    uint32_t sum = (uint32_t)val + GET_HL;
+    flag_carry = sum >> 16;
+    SET_HL(sum);
+}
 
-            calculate_non_carry_flags(reg_A);
-            flag_carry = temp_flag_carry;
-            break;
-        }
-        case INSTR_COMPLEMENT_ACCUMULATOR:
-            reg_A = ~reg_A;
-            break;
-        case INSTR_SET_CARRY:
-            flag_carry = true;
-            break;
-        case INSTR_COMPLEMENT_CARRY:
-            flag_carry = !flag_carry;
-            break;
-        case INSTR_RESTART_0:
-            call_sub(0x00);
-            break;
-        case INSTR_RESTART_1:
-            call_sub(0x08);
-            break;
-        case INSTR_RESTART_2:
-            call_sub(0x10);
-            break;
-        case INSTR_RESTART_3:
-            call_sub(0x18);
-            break;
-        case INSTR_RESTART_4:
-            call_sub(0x20);
-            break;
-        case INSTR_RESTART_5:
-            call_sub(0x28);
-            break;
-        case INSTR_RESTART_6:
-            call_sub(0x30);
-            break;
-        case INSTR_RESTART_7:
-            call_sub(0x38);
-            break;
-        case INSTR_CALL:
-            call_sub(get_swapped_bytes(instr.operand_16));
-            break;
-        case INSTR_CALL_IF_CARRY:
-            if (flag_carry) {
-                call_sub(get_swapped_bytes(instr.operand_16));
-            }
-            break;
-        case INSTR_CALL_IF_NO_CARRY:
-            if (!flag_carry) {
-                call_sub(get_swapped_bytes(instr.operand_16));
-            }
-            break;
-        case INSTR_CALL_IF_ZERO:
-            if (flag_zero) {
-                call_sub(get_swapped_bytes(instr.operand_16));
-            }
-            break;
-        case INSTR_CALL_IF_NOT_ZERO:
-            if (!flag_zero) {
-                call_sub(get_swapped_bytes(instr.operand_16));
-            }
-            break;
-        case INSTR_CALL_IF_MINUS:
-            if (flag_sign) {
-                call_sub(get_swapped_bytes(instr.operand_16));
-            }
-            break;
-        case INSTR_CALL_IF_PLUS:
-            if (!flag_sign) {
-                call_sub(get_swapped_bytes(instr.operand_16));
-            }
-            break;
-        case INSTR_CALL_IF_PARITY_EVEN:
-            if (flag_parity) {
-                call_sub(get_swapped_bytes(instr.operand_16));
-            }
-            break;
-        case INSTR_CALL_IF_PARITY_ODD:
-            if (!flag_parity) {
-                call_sub(get_swapped_bytes(instr.operand_16));
-            }
-            break;
-        case INSTR_LOAD_PROGRAM_COUNTER: {
-            uint16_t address = ((uint16_t)reg_H << 8) | reg_L;
-            pc = address;
+static inline void add_to_accumulator(uint8_t val, bool carry) {
+    uint16_t sum = (uint16_t)val + (uint16_t)reg_A + carry;
+    calculate_non_carry_flags(sum & 0xff);
+    flag_aux_carry = ((val & 0xf) + (reg_A & 0xf) + carry) > 0xf;
+    flag_carry = (sum >> 8) > 0;
+    reg_A = sum;
+}
+
+// Returns the difference without storing it, so CMP can share it
+static inline uint8_t subtract_from_accumulator(uint8_t val, bool borrow) {
+    uint16_t diff = ~((uint16_t)val + borrow) + 1 + (uint16_t)reg_A;
+    calculate_non_carry_flags(diff & 0xff);
+    flag_aux_carry = ~(reg_A ^ diff ^ val) & 0x10;
+    flag_carry = (diff >> 8) > 0;
+    return diff;
+}
+
+static inline void and_accumulator(uint8_t val) {
+    flag_aux_carry = ((reg_A | val) & 0x08) != 0;
+    reg_A = reg_A & val;
+    calculate_non_carry_flags(reg_A);
+    flag_carry = false;
+}
+
+static inline void xor_accumulator(uint8_t val) {
+    reg_A = reg_A ^ val;
+    calculate_non_carry_flags(reg_A);
+    flag_carry = false;
+    flag_aux_carry = false;
+}
+
+static inline void or_accumulator(uint8_t val) {
+    reg_A = reg_A | val;
+    calculate_non_carry_flags(reg_A);
+    flag_carry = false;
+    flag_aux_carry = false;
+}
+
+static inline void exchange_stack() {
+    uint8_t temp;
+    temp = reg_H;
+    reg_H = read_mem(sp + 1);
+    write_mem(sp + 1, temp);
+    temp = reg_L;
+    reg_L = read_mem(sp);
+    write_mem(sp, temp);
+}
+
+static inline void exchange_regs() {
+    uint8_t temp;
+    temp = reg_H;
+    reg_H = reg_D;
+    reg_D = temp;
+    temp = reg_L;
+    reg_L = reg_E;
+    reg_E = temp;
+}
+
+static inline void rotate_left(bool through_carry) {
+    bool old_carry = flag_carry;
+    flag_carry = reg_A & 0x80;
+    reg_A = reg_A << 1;
+    reg_A = reg_A | ((through_carry ? old_carry : flag_carry) ? 0x01 : 0x00);
+}
+
+static inline void rotate_right(bool through_carry) {
+    bool old_carry = flag_carry;
+    flag_carry = reg_A & 0x01;
+    reg_A = reg_A >> 1;
+    reg_A = reg_A | ((through_carry ? old_carry : flag_carry) ? 0x80 : 0x00);
+}
+
+static inline void decimal_adjust_accumulator() {
+    bool temp_flag_carry = flag_carry;
+    uint8_t low = reg_A & 0x0f;
+    uint8_t high = reg_A >> 4;
+
+    if ((low > 9) || flag_aux_carry) {
+        reg_A += 0x06;
+        flag_aux_carry = (low + 6) > 0x0f;
+    }
+
+    if ((high > 9) || flag_carry || (high == 9 && low > 9)) {
+        reg_A += 0x60;
+        temp_flag_carry = true;
+    }
+
+    calculate_non_carry_flags(reg_A);
+    flag_carry = temp_flag_carry;
+}
+
+// A taken conditional CALL or RET takes 6 cycles more than the
+// not-taken count in the decode table (17/11 and 11/5)
+#define TAKEN_BRANCH_CYCLES 6
+
+#ifdef CPU_PROFILE
+#define ADD_TAKEN_BRANCH_CYCLES() \
+    cycles += TAKEN_BRANCH_CYCLES; \
+    profile_cycles(pc - instr.byte_count, TAKEN_BRANCH_CYCLES)
+#else
+#define ADD_TAKEN_BRANCH_CYCLES() cycles += TAKEN_BRANCH_CYCLES
+#endif
+
+#define CALL_IF(cond) \
+    if (BRANCH_TAKEN(cond)) { \
+        ADD_TAKEN_BRANCH_CYCLES(); \
+        call_sub(instr.operand); \
+    }
+#define JUMP_IF(cond) if (BRANCH_TAKEN(cond)) pc = instr.operand
+#define RETURN_IF(cond) \
+    if (BRANCH_TAKEN(cond)) { \
+        ADD_TAKEN_BRANCH_CYCLES(); \
+        return_sub(); \
+    }
+
+// One handler per InstrType. exec_instr instantiates them once per
+// opcode with the registers from opcodes.h, so no handler has to look
+// up its operands at run time.
+#define EXEC_NOP(dst, src)
+#define EXEC_HALT(dst, src) is_halted = true
+#define EXEC_DISABLE_INTERRUPT(dst, src) is_interruptible = false
+#define EXEC_ENABLE_INTERRUPT(dst, src) \
+    is_interruptible = true; \
+    is_enable_delayed = true
+#define EXEC_OUTPUT(dst, src) output_ports[operand_8] = reg_A
+#define EXEC_INPUT(dst, src) \
+    if (input_hooks[operand_8] != NULL) { \
+        input_hooks[operand_8](operand_8); \
+    } \
+    reg_A = input_ports[operand_8]
+#define EXEC_DOUBLE_ADD(dst, src) double_add(GET_##dst)
+#define EXEC_INCREMENT_REG_PAIR(dst, src) SET_##dst(GET_##dst + 1)
+#define EXEC_DECREMENT_REG_PAIR(dst, src) SET_##dst(GET_##dst - 1)
+#define EXEC_POP(dst, src) SET_##dst(pop())
+#define EXEC_PUSH(dst, src) push(GET_##dst)
+#define EXEC_EXCHANGE_STACK(dst, src) exchange_stack()
+#define EXEC_LOAD_SP_FROM_HL(dst, src) sp = GET_HL
+#define EXEC_EXCHANGE_REGS(dst, src) exchange_regs()
+#define EXEC_LOAD_HL_DIRECT(dst, src) \
+    reg_H = read_mem(instr.operand + 1); \
+    reg_L = read_mem(instr.operand)
+#define EXEC_STORE_HL_DIRECT(dst, src) \
+    write_mem(instr.operand, reg_L); \
+    write_mem(instr.operand + 1, reg_H)
+#define EXEC_LOAD_REG_PAIR_IMMEDIATE(dst, src) SET_##dst(instr.operand)
+#define EXEC_STORE_ACCUMULATOR(dst, src) write_mem(GET_##dst, reg_A)
+#define EXEC_LOAD_ACCUMULATOR(dst, src) reg_A = read_mem(GET_##dst)
+#define EXEC_STORE_ACCUMULATOR_DIRECT(dst, src) write_mem(instr.operand, reg_A)
+#define EXEC_LOAD_ACCUMULATOR_DIRECT(dst, src) reg_A = read_mem(instr.operand)
+#define EXEC_MOVE_IMMEDIATE(dst, src) SET_##dst(operand_8)
+#define EXEC_MOVE(dst, src) SET_##dst(GET_##src)
+#define EXEC_INCREMENT_REG(dst, src) SET_##dst(increment(GET_##dst))
+#define EXEC_DECREMENT_REG(dst, src) SET_##dst(decrement(GET_##dst))
+#define EXEC_ROTATE_ACCUMULATOR_LEFT(dst, src) rotate_left(false)
+#define EXEC_ROTATE_ACCUMULATOR_RIGHT(dst, src) rotate_right(false)
+#define EXEC_ROTATE_ACCUMULATOR_LEFT_CARRY(dst, src) rotate_left(true)
+#define EXEC_ROTATE_ACCUMULATOR_RIGHT_CARRY(dst, src) rotate_right(true)
+#define EXEC_DECIMAL_ADJUST_ACCUMULATOR(dst, src) decimal_adjust_accumulator()
+#define EXEC_COMPLEMENT_ACCUMULATOR(dst, src) reg_A = ~reg_A
+#define EXEC_SET_CARRY(dst, src) flag_carry = true
+#define EXEC_COMPLEMENT_CARRY(dst, src) flag_carry = !flag_carry
+#define EXEC_RESTART_0(dst, src) call_sub(0x00)
+#define EXEC_RESTART_1(dst, src) call_sub(0x08)
+#define EXEC_RESTART_2(dst, src) call_sub(0x10)
+#define EXEC_RESTART_3(dst, src) call_sub(0x18)
+#define EXEC_RESTART_4(dst, src) call_sub(0x20)
+#define EXEC_RESTART_5(dst, src) call_sub(0x28)
+#define EXEC_RESTART_6(dst, src) call_sub(0x30)
+#define EXEC_RESTART_7(dst, src) call_sub(0x38)
+#define EXEC_CALL(dst, src) call_sub(instr.operand)
+#define EXEC_CALL_IF_CARRY(dst, src) CALL_IF(flag_carry)
+#define EXEC_CALL_IF_NO_CARRY(dst, src) CALL_IF(!flag_carry)
+#define EXEC_CALL_IF_ZERO(dst, src) CALL_IF(flag_zero)
+#define EXEC_CALL_IF_NOT_ZERO(dst, src) CALL_IF(!flag_zero)
+#define EXEC_CALL_IF_MINUS(dst, src) CALL_IF(flag_sign)
+#define EXEC_CALL_IF_PLUS(dst, src) CALL_IF(!flag_sign)
+#define EXEC_CALL_IF_PARITY_EVEN(dst, src) CALL_IF(flag_parity)
+#define EXEC_CALL_IF_PARITY_ODD(dst, src) CALL_IF(!flag_parity)
+#define EXEC_LOAD_PROGRAM_COUNTER(dst, src) pc = GET_HL
+#define EXEC_JUMP(dst, src) pc = instr.operand
+#define EXEC_JUMP_IF_CARRY(dst, src) JUMP_IF(flag_carry)
+#define EXEC_JUMP_IF_NO_CARRY(dst, src) JUMP_IF(!flag_carry)
+#define EXEC_JUMP_IF_ZERO(dst, src) JUMP_IF(flag_zero)
+#define EXEC_JUMP_IF_NOT_ZERO(dst, src) JUMP_IF(!flag_zero)
+#define EXEC_JUMP_IF_MINUS(dst, src) JUMP_IF(flag_sign)
+#define EXEC_JUMP_IF_PLUS(dst, src) JUMP_IF(!flag_sign)
+#define EXEC_JUMP_IF_PARITY_EVEN(dst, src) JUMP_IF(flag_parity)
+#define EXEC_JUMP_IF_PARITY_ODD(dst, src) JUMP_IF(!flag_parity)
+#define EXEC_RETURN(dst, src) return_sub()
+#define EXEC_RETURN_IF_CARRY(dst, src) RETURN_IF(flag_carry)
+#define EXEC_RETURN_IF_NO_CARRY(dst, src) RETURN_IF(!flag_carry)
+#define EXEC_RETURN_IF_ZERO(dst, src) RETURN_IF(flag_zero)
+#define EXEC_RETURN_IF_NOT_ZERO(dst, src) RETURN_IF(!flag_zero)
+#define EXEC_RETURN_IF_MINUS(dst, src) RETURN_IF(flag_sign)
+#define EXEC_RETURN_IF_PLUS(dst, src) RETURN_IF(!flag_sign)
+#define EXEC_RETURN_IF_PARITY_EVEN(dst, src) RETURN_IF(flag_parity)
+#define EXEC_RETURN_IF_PARITY_ODD(dst, src) RETURN_IF(!flag_parity)
+#define EXEC_ADD_REG(dst, src) add_to_accumulator(GET_##dst, false)
+#define EXEC_ADD_REG_WITH_CARRY(dst, src) \
+    add_to_accumulator(GET_##dst, flag_carry)
+#define EXEC_SUBTRACT_REG(dst, src) \
+    reg_A = subtract_from_accumulator(GET_##dst, false)
+#define EXEC_SUBTRACT_REG_WITH_BORROW(dst, src) \
+    reg_A = subtract_from_accumulator(GET_##dst, flag_carry)
+#define EXEC_AND_REG(dst, src) and_accumulator(GET_##dst)
+#define EXEC_XOR_REG(dst, src) xor_accumulator(GET_##dst)
+#define EXEC_OR_REG(dst, src) or_accumulator(GET_##dst)
+#define EXEC_COMPARE_REG(dst, src) subtract_from_accumulator(GET_##dst, false)
+#define EXEC_ADD_IMMEDIATE(dst, src) add_to_accumulator(operand_8, false)
+#define EXEC_ADD_IMMEDIATE_WITH_CARRY(dst, src) \
+    add_to_accumulator(operand_8, flag_carry)
+#define EXEC_SUBTRACT_IMMEDIATE(dst, src) \
+    reg_A = subtract_from_accumulator(operand_8, false)
+#define EXEC_SUBTRACT_IMMEDIATE_WITH_BORROW(dst, src) \
+    reg_A = subtract_from_accumulator(operand_8, flag_carry)
+#define EXEC_AND_IMMEDIATE(dst, src) and_accumulator(operand_8)
+#define EXEC_XOR_IMMEDIATE(dst, src) xor_accumulator(operand_8)
+#define EXEC_OR_IMMEDIATE(dst, src) or_accumulator(operand_8)
+#define EXEC_COMPARE_IMMEDIATE(dst, src) \
+    subtract_from_accumulator(operand_8, false)
+
+static void exec_fused_instr(Instr instr) {
+    switch (instr.type) {
+        case INSTR_FUSED_LOAD_A_INX_H: {
+            uint16_t address = GET_HL;
+            reg_A = read_mem(address);
+            SET_HL(address + 1);
             break;
         }
-        case INSTR_JUMP:
-            pc = get_swapped_bytes(instr.operand_16);
-            break;
-        case INSTR_JUMP_IF_CARRY:
-            if (flag_carry) {
-                pc = get_swapped_bytes(instr.operand_16);
-            }
-            break;
-        case INSTR_JUMP_IF_NO_CARRY:
-            if (!flag_carry) {
-                pc = get_swapped_bytes(instr.operand_16);
-            }
-            break;
-        case INSTR_JUMP_IF_ZERO:
-            if (flag_zero) {
-                pc = get_swapped_bytes(instr.operand_16);
-            }
-            break;
-        case INSTR_JUMP_IF_NOT_ZERO:
-            if (!flag_zero) {
-                pc = get_swapped_bytes(instr.operand_16);
-            }
-            break;
-        case INSTR_JUMP_IF_MINUS:
-            if (flag_sign) {
-                pc = get_swapped_bytes(instr.operand_16);
-            }
-            break;
-        case INSTR_JUMP_IF_PLUS:
-            if (!flag_sign) {
-                pc = get_swapped_bytes(instr.operand_16);
-            }
-            break;
-        case INSTR_JUMP_IF_PARITY_EVEN:
-            if (flag_parity) {
-                pc = get_swapped_bytes(instr.operand_16);
-            }
-            break;
-        case INSTR_JUMP_IF_PARITY_ODD:
-            if (!flag_parity) {
-                pc = get_swapped_bytes(instr.operand_16);
-            }
-            break;
-        case INSTR_RETURN:
-            return_sub();
-            break;
-        case INSTR_RETURN_IF_CARRY:
-            if (flag_carry) {
-                return_sub();
+        case INSTR_FUSED_DCR_JNZ:
+            if (instr.opcode == 0x05) {
+                reg_B = decrement(reg_B);
+            } else {
+                reg_C = decrement(reg_C);
             }
-            break;
-        case INSTR_RETURN_IF_NO_CARRY:
-            if (!flag_carry) {
-                return_sub();
-            }
-            break;
-        case INSTR_RETURN_IF_ZERO:
-            if (flag_zero) {
-                return_sub();
-            }
-            break;
-        case INSTR_RETURN_IF_NOT_ZERO:
             if (!flag_zero) {
-                return_sub();
-            }
-            break;
-        case INSTR_RETURN_IF_MINUS:
-            if (flag_sign) {
-                return_sub();
-            }
-            break;
-        case INSTR_RETURN_IF_PLUS:
-            if (!flag_sign) {
-                return_sub();
-            }
-            break;
-        case INSTR_RETURN_IF_PARITY_EVEN:
-            if (flag_parity) {
-                return_sub();
-            }
-            break;
-        case INSTR_RETURN_IF_PARITY_ODD:
-            if (!flag_parity) {
-                return_sub();
+                pc = instr.operand;
             }
             break;
-        case INSTR_ADD_REG: {
-            uint8_t *op_ptr = get_reg_op(instr.op_type);
-            uint16_t val = (uint16_t)*op_ptr + (uint16_t)reg_A;
-            calculate_non_carry_flags(val & 0xff);
-            flag_carry = (val >> 8) > 0;
-            flag_aux_carry = ((*op_ptr & 0xf) + (reg_A & 0xf)) > 0xf;
-            reg_A = val;
-            break;
-        }
-        case INSTR_ADD_REG_WITH_CARRY: {
-            uint8_t *op_ptr = get_reg_op(instr.op_type);
-            uint16_t val = (uint16_t)*op_ptr + (uint16_t)reg_A + flag_carry;
-            calculate_non_carry_flags(val & 0xff);
-            flag_aux_carry = ((*op_ptr & 0xf) + (reg_A & 0xf) 
-                             + flag_carry) > 0xf;
-            flag_carry = (val >> 8) > 0;
-            reg_A = val;
-            break;
-        }
-        case INSTR_SUBTRACT_REG: {
-            uint8_t *op_ptr = get_reg_op(instr.op_type);
-            uint16_t val = ~(uint16_t)*op_ptr + 1 + (uint16_t)reg_A;
-            calculate_non_carry_flags(val & 0xff);
-            flag_carry = (val >> 8) > 0;
-            flag_aux_carry = ~(reg_A ^ val ^ *op_ptr) & 0x10;
-            reg_A = val;
-            break;
-        }
-        case INSTR_SUBTRACT_REG_WITH_BORROW: {
-            uint8_t *op_ptr = get_reg_op(instr.op_type);
-            uint16_t val = ~((uint16_t)*op_ptr + flag_carry) + 1 
-                           + (uint16_t)reg_A;
-            calculate_non_carry_flags(val & 0xff);
-            flag_aux_carry = ~(reg_A ^ val ^ *op_ptr) & 0x10;
-            flag_carry = (val >> 8) > 0;
-            reg_A = val;
-            break;
-        }
-        case INSTR_AND_REG: {
-            uint8_t *op_ptr = get_reg_op(instr.op_type);
-            flag_aux_carry = ((reg_A | *op_ptr) & 0x08) != 0;
-            reg_A = reg_A & *op_ptr;
-            calculate_non_carry_flags(reg_A);
-            flag_carry = false;
-            break;
-        }
-        case INSTR_XOR_REG: {
-            uint8_t *op_ptr = get_reg_op(instr.op_type);
-            reg_A = reg_A ^ *op_ptr;
-            calculate_non_carry_flags(reg_A);
-            flag_carry = false;
-            flag_aux_carry = false;
-            break;
-        }
-        case INSTR_OR_REG: {
-            uint8_t *op_ptr = get_reg_op(instr.op_type);
-            reg_A = reg_A | *op_ptr;
-            calculate_non_carry_flags(reg_A);
-            flag_carry = false;
-            flag_aux_carry = false;
-            break;
-        }
-        case INSTR_COMPARE_REG: {
-            uint8_t *op_ptr = get_reg_op(instr.op_type);
-            uint16_t val = ~(uint16_t)*op_ptr + 1 + (uint16_t)reg_A;
-            calculate_non_carry_flags(val & 0xff);
-            flag_carry = (val >> 8) > 0;
-            flag_aux_carry = ~(reg_A ^ val ^ *op_ptr) & 0x10;
-            break;
-        }
-        case INSTR_ADD_IMMEDIATE: {
-            uint16_t val = (uint16_t)instr.operand_8_1 + (uint16_t)reg_A;
-            calculate_non_carry_flags(val & 0xff);
-            flag_carry = (val >> 8) > 0;
-            flag_aux_carry = ((instr.operand_8_1 & 0xf) + (reg_A & 0xf)) > 0xf;
-            reg_A = val;
-            break;
-        }
-        case INSTR_ADD_IMMEDIATE_WITH_CARRY: {
-            uint16_t val = (uint16_t)instr.operand_8_1 + (uint16_t)reg_A 
-                           + flag_carry;
-            calculate_non_carry_flags(val & 0xff);
-            flag_aux_carry = ((instr.operand_8_1 & 0xf) + (reg_A & 0xf) 
-                             + flag_carry) > 0xf;
-            flag_carry = (val >> 8) > 0;
-            reg_A = val;
-            break;
-        }
-        case INSTR_SUBTRACT_IMMEDIATE: {
-            uint16_t val = ~(uint16_t)instr.operand_8_1 + 1 + (uint16_t)reg_A;
-            calculate_non_carry_flags(val & 0xff);
-            flag_carry = (val >> 8) > 0;
-            flag_aux_carry = ~(reg_A ^ val ^ instr.operand_8_1) & 0x10;
-            reg_A = val;
-            break;
-        }
-        case INSTR_SUBTRACT_IMMEDIATE_WITH_BORROW: {
-            uint16_t val = ~((uint16_t)instr.operand_8_1 + flag_carry) + 1 
-                           + (uint16_t)reg_A;
-            calculate_non_carry_flags(val & 0xff);
-            flag_aux_carry = ~(reg_A ^ val ^ instr.operand_8_1) & 0x10;
-            flag_carry = (val >> 8) > 0;
-            reg_A = val;
-            break;
-        }
-        case INSTR_AND_IMMEDIATE:
-            flag_aux_carry = ((reg_A | instr.operand_8_1) & 0x08) != 0;
-            reg_A = reg_A & instr.operand_8_1;
-            calculate_non_carry_flags(reg_A);
-            flag_carry = false;
-            break;
-        case INSTR_XOR_IMMEDIATE:
-            reg_A = reg_A ^ instr.operand_8_1;
-            calculate_non_carry_flags(reg_A);
-            flag_carry = false;
-            flag_aux_carry = false;
-            break;
-        case INSTR_OR_IMMEDIATE:
-            reg_A = reg_A | instr.operand_8_1;
-            calculate_non_carry_flags(reg_A);
-            flag_carry = false;
-            flag_aux_carry = false;
-            break;
-        case INSTR_COMPARE_IMMEDIATE: {
-            uint16_t val = ~(uint16_t)instr.operand_8_1 + 1 + (uint16_t)reg_A;
-            calculate_non_carry_flags(val & 0xff);
-            flag_carry = (val >> 8) > 0;
-            flag_aux_carry = ~(reg_A ^ val ^instr.operand_8_1) & 0x10;
+        case INSTR_FUSED_COPY_DE_TO_HL: {
+            uint16_t source = GET_DE;
+            uint16_t dest = GET_HL;
+            reg_A = read_mem(source);
+            write_mem(dest, reg_A);
+            SET_DE(source + 1);
+            SET_HL(dest + 1);
             break;
         }
     }
-
-    return instr.cycle_count;
 }
 
-void process_interrupt_signal(IntSignal signal) {
-    Instr instr;
+int exec_instr(Instr instr) {
+    if (is_halted) {
+        return 0;
+    }
 
-    if (!is_interruptible) {
-        return;
+    if (trace_ring != NULL) {
+        record_trace(&instr);
     }
 
-    is_halted = false;
-    is_interruptible = false;
+#ifdef CPU_PROFILE
+    profile_instr(pc, instr.cycle_count);
+#endif
 
-    switch (signal) {
-        case INT_SIGNAL_0:
-            instr = populate_instr(INSTR_RESTART_0, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case INT_SIGNAL_1:
-            instr = populate_instr(INSTR_RESTART_1, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case INT_SIGNAL_2:
-            instr = populate_instr(INSTR_RESTART_2, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case INT_SIGNAL_3:
-            instr = populate_instr(INSTR_RESTART_3, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case INT_SIGNAL_4:
-            instr = populate_instr(INSTR_RESTART_4, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case INT_SIGNAL_5:
-            instr = populate_instr(INSTR_RESTART_5, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case INT_SIGNAL_6:
-            instr = populate_instr(INSTR_RESTART_6, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
-        case INT_SIGNAL_7:
-            instr = populate_instr(INSTR_RESTART_7, "RST", 11, 1,
-                                   INSTR_OP_NONE);
-            break;
+    uint8_t operand_8 = instr.operand;
+    int cycles = instr.cycle_count;
+
+    is_enable_delayed = false;
+    pc += instr.byte_count;
+
+    if (instr.type >= INSTR_FUSED_LOAD_A_INX_H) {
+        exec_fused_instr(instr);
+    } else {
+        switch (instr.opcode) {
+#define X(opcode, type, dst, src, mnemonic, registers, cycles, bytes) \
+            case opcode: { EXEC_##type(dst, src); } break;
+            FOR_EACH_OPCODE(X)
+#undef X
+        }
     }
 
-    // TODO: This is a hack. Should be done better.
-    // Decrement PC by the byte count of the RESTART opcode
-    // because exec_instr is going to increment by that amount
-    pc -= instr.byte_count;
-    exec_instr(instr);
+    cycle_counter += cycles;
+    return cycles;
+}
+
+// Latches RST n for interrupt n. fetch_instr accepts it at the next
+// instruction boundary where interrupts are enabled, until then a
+// newer interrupt replaces it.
+void raise_interrupt(IntSignal signal) {
+    is_interrupt_pending = true;
+    pending_interrupt_opcode = 0xc7 | (signal << 3);
 }
 
 uint8_t read_port(uint8_t id) {
@@ -1894,6 +920,12 @@ bool read_port_bit(uint8_t id, uint8_t bit_n) {
     return output_ports[id] & (0x01 << bit_n);
 }
 
+// Unlike PC hooks and watchpoints these are part of the machine, so
+// they are never compiled out
+void set_input_hook(uint8_t id, InputHook hook) {
+    input_hooks[id] = hook;
+}
+
 void write_port(uint8_t id, uint8_t value) {
     input_ports[id] = value;
 }
@@ -4,6 +4,17 @@
 
 #include <stdint.h>
 
+// Names the instruction execution strategy so that benchmark results
+// from different implementations can be told apart
+#define CPU_BACKEND "switch"
+
+#define MAX_PC_HOOKS 16
+#define MAX_WATCHPOINTS 16
+
+// Access types for add_watchpoint
+#define WATCH_READ  0x1
+#define WATCH_WRITE 0x2
+
 typedef enum InstrType {
     INSTR_NOP,
     INSTR_HALT,
@@ -89,41 +100,13 @@ typedef enum InstrType {
     INSTR_AND_IMMEDIATE,
     INSTR_XOR_IMMEDIATE,
     INSTR_OR_IMMEDIATE,
-    INSTR_COMPARE_IMMEDIATE
+    INSTR_COMPARE_IMMEDIATE,
+    // Sequences run as one instruction by fetch_fused_instr
+    INSTR_FUSED_LOAD_A_INX_H,
+    INSTR_FUSED_DCR_JNZ,
+    INSTR_FUSED_COPY_DE_TO_HL
 } InstrType;
 
-typedef enum InstrOpType {
-    INSTR_OP_NONE,
-    INSTR_OP_SINGLE_8,
-    INSTR_OP_DOUBLE_8,
-    INSTR_OP_16,
-    INSTR_OP_REG_PAIR_B,
-    INSTR_OP_REG_PAIR_D,
-    INSTR_OP_REG_PAIR_H,
-    INSTR_OP_REG_PAIR_SP,
-    INSTR_OP_REG_PAIR_PSW,
-    INSTR_OP_REG_PAIR_B_AND_OP_16,
-    INSTR_OP_REG_PAIR_D_AND_OP_16,
-    INSTR_OP_REG_PAIR_H_AND_OP_16,
-    INSTR_OP_REG_PAIR_SP_AND_OP_16,
-    INSTR_OP_REG_B,
-    INSTR_OP_REG_C,
-    INSTR_OP_REG_D,
-    INSTR_OP_REG_E,
-    INSTR_OP_REG_H,
-    INSTR_OP_REG_L,
-    INSTR_OP_REG_A,
-    INSTR_OP_MEM_REF,
-    INSTR_OP_REG_B_AND_OP_8,
-    INSTR_OP_REG_C_AND_OP_8,
-    INSTR_OP_REG_D_AND_OP_8,
-    INSTR_OP_REG_E_AND_OP_8,
-    INSTR_OP_REG_H_AND_OP_8,
-    INSTR_OP_REG_L_AND_OP_8,
-    INSTR_OP_REG_A_AND_OP_8,
-    INSTR_OP_MEM_REF_AND_OP_8
-} InstrOpType;
-
 typedef enum IntSignal {
     INT_SIGNAL_0,
     INT_SIGNAL_1,
@@ -135,21 +118,43 @@ typedef enum IntSignal {
     INT_SIGNAL_7
 } IntSignal;
 
+// Decoded instruction as executed, packed into 6 bytes so the decode
+// cache for the whole address space stays small. Register operands are
+// implied by the opcode (see opcodes.h), and mnemonics and operand
+// syntax are only needed by tools, see disasm.h.
 typedef struct Instr {
-    InstrType type;
-    uint16_t address;
+    uint8_t type;           // InstrType
     uint8_t opcode;
-    char mnemonic[5];
-    int cycle_count;
-    int byte_count;
-    InstrOpType op_type;
-    uint8_t operand_8_1;
-    uint8_t operand_8_2;
-    uint16_t operand_16;
-    InstrOpType move_source;
-    InstrOpType move_destination;
+    uint8_t cycle_count;
+    uint8_t byte_count;
+    // Immediate operand in little-endian order, ready to use as an
+    // address
+    uint16_t operand;
 } Instr;
 
+// Guest instructions an Instr runs, more than one for fused sequences,
+// so instruction counts don't depend on fusion
+static inline int get_guest_instr_count(Instr instr) {
+    if (instr.type < INSTR_FUSED_LOAD_A_INX_H) {
+        return 1;
+    }
+    return instr.type == INSTR_FUSED_COPY_DE_TO_HL ? 4 : 2;
+}
+
+// Defined in trace.h
+struct TraceRing;
+
+// Called with the address of the instruction about to be fetched
+typedef void (*PcHook)(uint16_t);
+
+// Called by IN for its port before the port is read, so a device can
+// set the port to its state at that moment
+typedef void (*InputHook)(uint8_t);
+
+// Called with the address, the value read or written and whether
+// the access was a write
+typedef void (*WatchHook)(uint16_t, uint8_t, bool);
+
 typedef struct CpuInnards {
     uint16_t *pc;
     uint16_t *sp;
@@ -177,9 +182,20 @@ typedef struct CpuInnards {
 
 void init_cpu(uint8_t *);
 CpuInnards expose_cpu_internals(void);
+uint64_t get_cycle_count(void);
+void set_trace_ring(struct TraceRing *);
+void flush_decode_cache(void);
+bool register_pc_hook(uint16_t, PcHook);
+void remove_pc_hook(uint16_t, PcHook);
+void clear_pc_hooks(void);
+bool add_watchpoint(uint16_t, uint16_t, uint8_t, WatchHook);
+void remove_watchpoint(uint16_t, uint16_t, WatchHook);
+void clear_watchpoints(void);
+void set_input_hook(uint8_t, InputHook);
 Instr fetch_instr(void);
+Instr fetch_fused_instr(int);
 int exec_instr(Instr);
-void process_interrupt_signal(IntSignal);
+void raise_interrupt(IntSignal);
 uint8_t read_port(uint8_t);
 bool read_port_bit(uint8_t, uint8_t);
 void write_port(uint8_t, uint8_t);
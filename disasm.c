@@ -0,0 +1,38 @@
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "disasm.h"
+#include "opcodes.h"
+
+// Indexed by opcode
+static const DisasmInfo disasm_table[256] = {
+#define X(opcode, type, dst, src, mnemonic, registers, cycles, bytes) \
+    [opcode] = { mnemonic, registers, bytes },
+    FOR_EACH_OPCODE(X)
+#undef X
+};
+
+const DisasmInfo *get_disasm_info(uint8_t opcode) {
+    return &disasm_table[opcode];
+}
+
+// Writes the instruction starting at `bytes` as "MNEM operands" into
+// `out`, reading up to three bytes. Returns the instruction length.
+int disassemble(const uint8_t *bytes, char *out, size_t size) {
+    const DisasmInfo *info = &disasm_table[bytes[0]];
+    const char *separator = info->registers[0] != '\0' ? "," : "";
+
+    if (info->byte_count == 2) {
+        snprintf(out, size, "%-4s %s%s0x%02x", info->mnemonic,
+                 info->registers, separator, bytes[1]);
+    } else if (info->byte_count == 3) {
+        snprintf(out, size, "%-4s %s%s0x%04x", info->mnemonic,
+                 info->registers, separator, bytes[1] | (bytes[2] << 8));
+    } else {
+        snprintf(out, size, "%-4s %s", info->mnemonic, info->registers);
+    }
+
+    return info->byte_count;
+}
@@ -0,0 +1,22 @@
+
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What the tools need to print an instruction. The CPU core itself
+// never looks at this.
+typedef struct DisasmInfo {
+    const char *mnemonic;
+    // Register operands as written in assembly, e.g. "A,M", "SP" or
+    // the RST number, empty when there are none
+    const char *registers;
+    // 2 means an 8-bit immediate follows the opcode, 3 a 16-bit one
+    uint8_t byte_count;
+} DisasmInfo;
+
+const DisasmInfo *get_disasm_info(uint8_t);
+int disassemble(const uint8_t *, char *, size_t);
+
+#endif
@@ -1,28 +1,35 @@
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <SDL.h>
 
-#define PIXEL_COUNT_WIDTH 224
-#define PIXEL_COUNT_HEIGHT 256
+#include "framebuffer.h"
+#include "perfstats.h"
+#include "timeline.h"
 
 #define PIXEL_WIDTH 2
 #define PIXEL_HEIGHT 2
-#define WINDOW_WIDTH (PIXEL_COUNT_WIDTH * PIXEL_WIDTH)
-#define WINDOW_HEIGHT (PIXEL_COUNT_HEIGHT * PIXEL_HEIGHT)
-
-#define GREEN   0, 255,   0
-#define RED   255,   0,   0
-#define WHITE 255, 255, 255
-
-#define GREEN_BOUNDARY       184
-#define RED_BOUNDARY_TOP      33
-#define RED_BOUNDARY_BOTTOM   55
+#define WINDOW_WIDTH (SCREEN_WIDTH * PIXEL_WIDTH)
+#define WINDOW_HEIGHT (SCREEN_HEIGHT * PIXEL_HEIGHT)
+#define DEFAULT_REFRESH_RATE 60
 
 static SDL_Window *window = NULL;
 static SDL_Renderer *renderer = NULL;
+static SDL_Texture *texture = NULL;
 
 static uint8_t *v_ram = NULL;
+static uint32_t pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+// The latest finished frame, handed from the emulation thread to the
+// thread that owns the renderer
+static uint32_t shown_pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+static pthread_mutex_t shown_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_bool is_frame_queued = false;
+static uint32_t frame_event_type = 0;
 
 void init_display(uint8_t *mem) {
     window = SDL_CreateWindow("Space Invaders", SDL_WINDOWPOS_UNDEFINED,
@@ -33,46 +40,70 @@ void init_display(uint8_t *mem) {
 
 
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH,
+                                SCREEN_HEIGHT);
+    frame_event_type = SDL_RegisterEvents(1);
 }
 
-void update_display(void) {
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
+// Event posted by render_frame when a frame is ready to present
+uint32_t get_frame_event_type(void) {
+    return frame_event_type;
+}
 
-    SDL_Rect pixel;
-
-    int x_pos = 0;
-    int y_pos = 256;
-    for (int i = 0; i < 7168; i++) {
-        uint8_t byte = v_ram[i];
-        for (int j = 0; j < 8; j++) {
-            if (byte & 0x01) {
-                pixel.x = x_pos * PIXEL_WIDTH;
-                pixel.y = y_pos * PIXEL_HEIGHT;
-                pixel.w = PIXEL_WIDTH;
-                pixel.h = PIXEL_HEIGHT;
-
-                if (y_pos > GREEN_BOUNDARY) {
-                    SDL_SetRenderDrawColor(renderer, GREEN, 255);
-                } else if (y_pos > RED_BOUNDARY_TOP &&
-                           y_pos < RED_BOUNDARY_BOTTOM) {
-                    SDL_SetRenderDrawColor(renderer, RED, 255);
-                } else {
-                    SDL_SetRenderDrawColor(renderer, WHITE, 255);
-                }
-
-                SDL_RenderFillRect(renderer, &pixel);
-            }
-
-            byte = byte >> 1;
-            y_pos--;
-        }
-
-        if (y_pos == 0) {
-            y_pos = 256;
-            x_pos++;
-        }
+// Refresh rate of the display the window is on, 60 Hz if unknown. Only
+// call this from the event thread.
+int get_refresh_rate(void) {
+    SDL_DisplayMode mode;
+    int index = SDL_GetWindowDisplayIndex(window);
+
+    if (index < 0 || SDL_GetCurrentDisplayMode(index, &mode) != 0 ||
+        mode.refresh_rate <= 0) {
+        return DEFAULT_REFRESH_RATE;
     }
+    return mode.refresh_rate;
+}
+
+// Called from the emulation thread. VRAM is converted straight away so
+// the frame matches the moment of the interrupt, presenting is left to
+// the event thread. At most one frame event is queued at a time, a
+// newer frame simply replaces the one waiting. `overlay` may be NULL.
+void render_frame(const PerfStats *overlay) {
+    draw_frame(v_ram, pixels);
+    if (overlay != NULL) {
+        draw_perf_overlay(overlay, pixels);
+    }
+
+    pthread_mutex_lock(&shown_lock);
+    memcpy(shown_pixels, pixels, sizeof shown_pixels);
+    pthread_mutex_unlock(&shown_lock);
+
+    if (!atomic_exchange(&is_frame_queued, true)) {
+        SDL_Event e;
+        SDL_zero(e);
+        e.type = frame_event_type;
+        SDL_PushEvent(&e);
+    }
+}
+
+// Whether the last frame handed over hasn't been presented yet
+bool is_frame_pending(void) {
+    return atomic_load(&is_frame_queued);
+}
+
+// Called from the thread that created the display
+void present_frame(void) {
+    atomic_store(&is_frame_queued, false);
+
+    pthread_mutex_lock(&shown_lock);
+    SDL_UpdateTexture(texture, NULL, shown_pixels,
+                      SCREEN_WIDTH * sizeof shown_pixels[0]);
+    pthread_mutex_unlock(&shown_lock);
+
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
 
+    uint64_t start = begin_timeline_event();
     SDL_RenderPresent(renderer);
+    end_timeline_event("SDL_RenderPresent", start);
 }
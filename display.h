@@ -2,9 +2,16 @@
 #ifndef DISPLAY_H
 #define DISPLAY_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "perfstats.h"
+
 void init_display(uint8_t *);
-void update_display(void);
+int get_refresh_rate(void);
+uint32_t get_frame_event_type(void);
+void render_frame(const PerfStats *);
+bool is_frame_pending(void);
+void present_frame(void);
 
 #endif
@@ -0,0 +1,360 @@
+#include <glob.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../cpu.h"
+#include "../machine.h"
+#include "../replay.h"
+
+#ifdef ORIGINAL_CPU
+#include "original-cpu.h"
+#endif
+
+#define GOLDEN_FILE_HEADER "# space invaders frame hashes v2"
+
+#define DEFAULT_CASES "cases/*.inputs"
+#define DEFAULT_FRAME_COUNT 3600
+
+// Video RAM, 0x2400 to 0x3fff
+#define VRAM_START 0x2400
+#define VRAM_SIZE 0x1c00
+
+typedef struct FrameHashes {
+    uint64_t *hashes;
+    int count;
+} FrameHashes;
+
+static char *rom_path = "../invaders.rom";
+static int frame_count = DEFAULT_FRAME_COUNT;
+static bool is_updating = false;
+
+// FNV-1a
+static uint64_t hash_vram(const uint8_t *mem) {
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (int i = 0; i < VRAM_SIZE; i++) {
+        hash ^= mem[VRAM_START + i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+// Same slice as the game and the benchmark
+static void run_slice(void) {
+    int cycle_count = 0;
+
+    while (cycle_count < CYCLES_PER_SLICE) {
+#ifdef ORIGINAL_CPU
+        cycle_count += step_original_cpu();
+#else
+        Instr instr = fetch_fused_instr(CYCLES_PER_SLICE - cycle_count);
+        cycle_count += exec_instr(instr);
+#endif
+        process_shift_register();
+        process_sound();
+    }
+}
+
+// "foo.inputs" becomes "foo<suffix>"
+static char *get_case_path(char *script_path, char *suffix) {
+    char *dot = strrchr(script_path, '.');
+    size_t len = dot != NULL ? (size_t)(dot - script_path)
+                             : strlen(script_path);
+    char *path = malloc(len + strlen(suffix) + 1);
+
+    memcpy(path, script_path, len);
+    strcpy(path + len, suffix);
+    return path;
+}
+
+// The header is followed by "frames <count>" and then one
+// "<frame> <hash>" line per frame, so a truncated file is caught
+static bool read_golden(FrameHashes *golden, char *path) {
+    FILE *fp = fopen(path, "r");
+    char line[128];
+    int expected_count = 0;
+
+    if (fp == NULL) {
+        printf("Error opening golden hashes %s, generate them with -u\n",
+               path);
+        return false;
+    }
+
+    if (fgets(line, sizeof line, fp) == NULL ||
+        strncmp(line, GOLDEN_FILE_HEADER, strlen(GOLDEN_FILE_HEADER)) != 0) {
+        printf("Error: %s is not a frame hash file\n", path);
+        fclose(fp);
+        return false;
+    }
+
+    while (fgets(line, sizeof line, fp) != NULL && line[0] == '#') {
+        // Skip comments between the header and the frame count
+    }
+    if (sscanf(line, "frames %d", &expected_count) != 1 ||
+        expected_count <= 0) {
+        printf("Error: %s has no frame count\n", path);
+        fclose(fp);
+        return false;
+    }
+
+    golden->hashes = malloc(expected_count * sizeof(uint64_t));
+    golden->count = 0;
+
+    while (fgets(line, sizeof line, fp) != NULL) {
+        unsigned int frame;
+        unsigned long long hash;
+
+        if (line[0] == '#' ||
+            sscanf(line, "%u %llx", &frame, &hash) != 2) {
+            continue;
+        }
+        if (frame != (unsigned int)golden->count ||
+            golden->count == expected_count) {
+            printf("Error: %s has frame %u where frame %d was expected\n",
+                   path, frame, golden->count);
+            fclose(fp);
+            return false;
+        }
+        golden->hashes[golden->count++] = hash;
+    }
+
+    fclose(fp);
+    if (golden->count != expected_count) {
+        printf("Error: %s is truncated, %d of %d frames\n", path,
+               golden->count, expected_count);
+        return false;
+    }
+    return true;
+}
+
+static bool write_golden(FrameHashes *hashes, char *path) {
+    FILE *fp = fopen(path, "w");
+
+    if (fp == NULL) {
+        printf("Error opening golden hashes %s\n", path);
+        return false;
+    }
+
+    fprintf(fp, "%s\n", GOLDEN_FILE_HEADER);
+    fprintf(fp, "frames %d\n", hashes->count);
+    for (int i = 0; i < hashes->count; i++) {
+        fprintf(fp, "%d %016llx\n", i, (unsigned long long)hashes->hashes[i]);
+    }
+
+    fclose(fp);
+    return true;
+}
+
+// Registers and flags as text next to a raw copy of the 64K address
+// space, so the state can be compared with a run of the reference build
+static void dump_state(char *script_path, int frame) {
+    CpuInnards cpu = expose_cpu_internals();
+    char suffix[32];
+
+    snprintf(suffix, sizeof suffix, ".frame%d.txt", frame);
+    char *text_path = get_case_path(script_path, suffix);
+    snprintf(suffix, sizeof suffix, ".frame%d.mem", frame);
+    char *mem_path = get_case_path(script_path, suffix);
+
+    FILE *fp = fopen(text_path, "w");
+    if (fp != NULL) {
+        fprintf(fp, "frame %d\ncycle %llu\n", frame,
+                (unsigned long long)get_cycle_count());
+        fprintf(fp, "PC %04x SP %04x\n", *(cpu.pc), *(cpu.sp));
+        fprintf(fp, "A %02x B %02x C %02x D %02x E %02x H %02x L %02x\n",
+                *(cpu.reg_A), *(cpu.reg_B), *(cpu.reg_C), *(cpu.reg_D),
+                *(cpu.reg_E), *(cpu.reg_H), *(cpu.reg_L));
+        fprintf(fp, "S %d Z %d AC %d P %d CY %d\n", *(cpu.flag_sign),
+                *(cpu.flag_zero), *(cpu.flag_aux_carry), *(cpu.flag_parity),
+                *(cpu.flag_carry));
+        fprintf(fp, "halted %d interruptible %d\n", *(cpu.is_halted),
+                *(cpu.is_interruptible));
+        fclose(fp);
+    }
+
+    fp = fopen(mem_path, "wb");
+    if (fp != NULL) {
+        fwrite(get_machine_memory(), 1, 65536, fp);
+        fclose(fp);
+    }
+
+    printf("    state dumped to %s and %s\n", text_path, mem_path);
+    free(text_path);
+    free(mem_path);
+}
+
+// Runs in the forked child. Plays the script and hashes VRAM at every
+// full draw interrupt, then either compares the hashes with the golden
+// file or replaces it.
+static bool run_case(char *script_path) {
+    InputScript script;
+    FrameHashes golden = {0};
+    FrameHashes hashes;
+    char *golden_path = get_case_path(script_path, ".hashes");
+    bool passed = true;
+
+    if (!load_input_script(&script, script_path)) {
+        return false;
+    }
+    if (!is_updating) {
+        if (!read_golden(&golden, golden_path)) {
+            return false;
+        }
+        frame_count = golden.count;
+    }
+
+    // Inputs the hashes don't reach would go unchecked
+    if (script.event_count > 0 &&
+        script.events[script.event_count - 1].frame >=
+        (uint32_t)frame_count) {
+        printf("%-32s FAIL  %d frames end before the last input at "
+               "frame %u\n", script_path, frame_count,
+               script.events[script.event_count - 1].frame);
+        return false;
+    }
+
+    hashes.hashes = malloc(frame_count * sizeof(uint64_t));
+    hashes.count = frame_count;
+
+    init_machine(rom_path);
+    uint8_t *mem = get_machine_memory();
+
+    for (int frame = 0; frame < frame_count; frame++) {
+        apply_inputs(get_script_inputs(&script, frame));
+
+        run_slice();
+        half_draw_interrupt();
+
+        run_slice();
+        hashes.hashes[frame] = hash_vram(mem);
+
+        if (!is_updating && hashes.hashes[frame] != golden.hashes[frame]) {
+            printf("%-32s FAIL  frame %d differs (expected %016llx, "
+                   "got %016llx)\n", script_path, frame,
+                   (unsigned long long)golden.hashes[frame],
+                   (unsigned long long)hashes.hashes[frame]);
+            dump_state(script_path, frame);
+            passed = false;
+            break;
+        }
+
+        full_draw_interrupt();
+    }
+
+    if (is_updating) {
+        passed = write_golden(&hashes, golden_path);
+        if (passed) {
+            printf("%-32s wrote %d hashes to %s\n", script_path, frame_count,
+                   golden_path);
+        }
+    } else if (passed) {
+        printf("%-32s PASS  %d frames\n", script_path, frame_count);
+    }
+
+    free(hashes.hashes);
+    free(golden.hashes);
+    free(golden_path);
+    free_input_script(&script);
+    return passed;
+}
+
+// Every case runs in its own process, at most `jobs` at a time, since
+// the CPU and the machine are process-wide singletons
+static int run_all(char **paths, int count, int jobs) {
+    int running = 0;
+    int failures = 0;
+    int status;
+
+    for (int next = 0; next < count || running > 0;) {
+        while (running < jobs && next < count) {
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork");
+                exit(1);
+            }
+            if (pid == 0) {
+                bool passed = run_case(paths[next]);
+                fflush(stdout);
+                _exit(passed ? 0 : 1);
+            }
+            next++;
+            running++;
+        }
+
+        if (wait(&status) < 0) {
+            perror("wait");
+            exit(1);
+        }
+        running--;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+static void print_usage(char *name) {
+    printf("Usage: %s [-u] [-f frames] [-j jobs] [-r rom] "
+           "[input_script...]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    glob_t found = {0};
+    char **paths;
+    int path_count;
+    int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "uf:j:r:h")) != -1) {
+        switch (opt) {
+            case 'u':
+                is_updating = true;
+                break;
+            case 'f':
+                frame_count = atoi(optarg);
+                break;
+            case 'j':
+                jobs = atoi(optarg);
+                break;
+            case 'r':
+                rom_path = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    if (frame_count <= 0) {
+        print_usage(argv[0]);
+        exit(1);
+    }
+
+    if (optind < argc) {
+        paths = &argv[optind];
+        path_count = argc - optind;
+    } else {
+        if (glob(DEFAULT_CASES, 0, NULL, &found) != 0) {
+            printf("No input scripts matching %s\n", DEFAULT_CASES);
+            exit(1);
+        }
+        paths = found.gl_pathv;
+        path_count = found.gl_pathc;
+    }
+
+    int failures = run_all(paths, path_count, jobs);
+
+    printf("%d of %d cases %s\n", path_count - failures, path_count,
+           is_updating ? "updated" : "passed");
+    globfree(&found);
+    return failures > 0;
+}
@@ -0,0 +1,98 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// The original core's header, found through -I original
+#include "cpu.h"
+
+#include "original-cpu.h"
+
+// Adapts the core from the first commit, before the decode cache, the
+// fused instructions and the interrupt latch, to the interface the
+// machine and frame-hash use now, so golden hashes can be generated
+// with it. Its cpu.c is built with init_cpu renamed to
+// init_original_cpu so it can be wrapped here.
+//
+// Two changes since then were deliberate and are applied here so the
+// hashes can match:
+//  - Interrupts are latched while disabled and accepted at the next
+//    instruction boundary once enabled, not before the instruction
+//    after EI (user-039). The original core dropped them.
+//  - Taken conditional CALL and RET cost 6 cycles more, and XCHG one
+//    cycle less (user-038). The cycles decide where slices end and so
+//    where the interrupts land.
+
+#define TAKEN_BRANCH_CYCLES 6
+#define INTERRUPT_CYCLES 11
+
+typedef void (*InputHook)(uint8_t);
+
+void init_original_cpu(uint8_t *);
+
+static CpuInnards cpu;
+static uint64_t cycle_counter = 0;
+static bool is_interrupt_pending = false;
+static IntSignal pending_signal = INT_SIGNAL_0;
+static bool is_enable_delayed = false;
+static InputHook input_hooks[256];
+
+void init_cpu(uint8_t *mem) {
+    init_original_cpu(mem);
+    cpu = expose_cpu_internals();
+
+    cycle_counter = 0;
+    is_interrupt_pending = false;
+    is_enable_delayed = false;
+    memset(input_hooks, 0, sizeof input_hooks);
+}
+
+uint64_t get_cycle_count(void) {
+    return cycle_counter;
+}
+
+void set_input_hook(uint8_t port, InputHook hook) {
+    input_hooks[port] = hook;
+}
+
+void raise_interrupt(IntSignal signal) {
+    is_interrupt_pending = true;
+    pending_signal = signal;
+}
+
+static bool is_conditional_call_or_return(uint8_t opcode) {
+    return (opcode & 0xc7) == 0xc4 || (opcode & 0xc7) == 0xc0;
+}
+
+// Runs one instruction, or accepts a latched interrupt, and returns
+// the cycles it took
+int step_original_cpu(void) {
+    if (is_interrupt_pending && *(cpu.is_interruptible) &&
+        !is_enable_delayed) {
+        is_interrupt_pending = false;
+        process_interrupt_signal(pending_signal);
+        cycle_counter += INTERRUPT_CYCLES;
+        return INTERRUPT_CYCLES;
+    }
+
+    Instr instr = fetch_instr();
+
+    if (*(cpu.is_halted)) {
+        return 0;
+    }
+    if (instr.type == INSTR_INPUT && input_hooks[instr.operand_8_1]) {
+        input_hooks[instr.operand_8_1](instr.operand_8_1);
+    }
+
+    int cycles = exec_instr(instr);
+
+    is_enable_delayed = instr.type == INSTR_ENABLE_INTERRUPT;
+    if (instr.opcode == 0xeb) {
+        cycles--;
+    } else if (is_conditional_call_or_return(instr.opcode) &&
+               *(cpu.pc) != (uint16_t)(instr.address + instr.byte_count)) {
+        cycles += TAKEN_BRANCH_CYCLES;
+    }
+
+    cycle_counter += cycles;
+    return cycles;
+}
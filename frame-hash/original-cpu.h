@@ -0,0 +1,7 @@
+
+#ifndef ORIGINAL_CPU_H
+#define ORIGINAL_CPU_H
+
+int step_original_cpu(void);
+
+#endif
@@ -0,0 +1,49 @@
+
+#include <stdint.h>
+
+#include "framebuffer.h"
+
+// Pixels are ARGB8888
+#define BLACK 0xff000000
+#define GREEN 0xff00ff00
+#define RED   0xffff0000
+#define WHITE 0xffffffff
+
+#define GREEN_BOUNDARY       184
+#define RED_BOUNDARY_TOP      33
+#define RED_BOUNDARY_BOTTOM   55
+
+// Converts the 7168 bytes of video RAM into a SCREEN_WIDTH by
+// SCREEN_HEIGHT pixel buffer. The screen in the cabinet is rotated,
+// so each byte holds 8 vertical pixels, drawn from the bottom up.
+void draw_frame(const uint8_t *v_ram, uint32_t *pixels) {
+    int x_pos = 0;
+    int y_pos = 256;
+    for (int i = 0; i < 7168; i++) {
+        uint8_t byte = v_ram[i];
+        for (int j = 0; j < 8; j++) {
+            uint32_t color = BLACK;
+
+            if (byte & 0x01) {
+                if (y_pos > GREEN_BOUNDARY) {
+                    color = GREEN;
+                } else if (y_pos > RED_BOUNDARY_TOP &&
+                           y_pos < RED_BOUNDARY_BOTTOM) {
+                    color = RED;
+                } else {
+                    color = WHITE;
+                }
+            }
+
+            pixels[(y_pos - 1) * SCREEN_WIDTH + x_pos] = color;
+
+            byte = byte >> 1;
+            y_pos--;
+        }
+
+        if (y_pos == 0) {
+            y_pos = 256;
+            x_pos++;
+        }
+    }
+}
@@ -0,0 +1,12 @@
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdint.h>
+
+#define SCREEN_WIDTH 224
+#define SCREEN_HEIGHT 256
+
+void draw_frame(const uint8_t *, uint32_t *);
+
+#endif
@@ -0,0 +1,206 @@
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "machine.h"
+
+#ifdef EMBED_ASSETS
+#include "assets.h"
+#endif
+
+static uint8_t memory[65536] = {0};
+
+static void (*sound_handler)(SoundEvent) = NULL;
+
+// Latest input mask, written by whichever thread handles input and
+// only read when the game executes IN 1 or IN 2
+static _Atomic uint8_t input_snapshot = 0;
+
+static void sample_inputs(uint8_t);
+
+#ifdef EMBED_ASSETS
+static void load_memory(char *path) {
+    (void)path;
+    size_t size = embedded_rom_size < sizeof memory ? embedded_rom_size :
+                                                      sizeof memory;
+    memset(memory, 0, sizeof memory);
+    memcpy(memory, embedded_rom, size);
+}
+#else
+// Maps the ROM and copies it into memory, anything past 64 KB is
+// ignored
+static void load_memory(char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        printf("Error opening ROM file\n");
+        exit(1);
+    }
+
+    size_t size = st.st_size < 65536 ? st.st_size : 65536;
+    void *rom = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (rom == MAP_FAILED) {
+        printf("Error mapping ROM file\n");
+        exit(1);
+    }
+
+    memset(memory, 0, sizeof memory);
+    memcpy(memory, rom, size);
+
+    munmap(rom, size);
+    close(fd);
+}
+#endif
+
+static void set_dip_switches() {
+    // bit 0 = DIP3
+    // bit 1 = DIP5
+    // bits 1 & 0
+    //   00 = 3 ships
+    //   01 = 4 ships
+    //   10 = 5 ships
+    //   11 = 6 ships
+    write_port_bit(2, 0, 1);
+    write_port_bit(2, 1, 1);
+
+    // bit 3 = DIP6
+    // 0 = extra ship at 1500
+    // 1 = extra ship at 1000
+    write_port_bit(2, 3, 1);
+
+    // bit 7 = DIP7
+    // 0 = display coin info on demo screen
+    // 1 = don't display coin info on demo screen
+    write_port_bit(2, 7, 0);
+}
+
+void init_machine(char *rom_path) {
+    load_memory(rom_path);
+    init_cpu(memory);
+    set_dip_switches();
+    atomic_store(&input_snapshot, 0);
+    set_input_hook(1, sample_inputs);
+    set_input_hook(2, sample_inputs);
+}
+
+uint8_t *get_machine_memory(void) {
+    return memory;
+}
+
+// Sounds are only triggered when a handler has been set, so the
+// machine can be run headless
+void set_sound_handler(void (*handler)(SoundEvent)) {
+    sound_handler = handler;
+}
+
+// Generate this interrupt when screen is half way drawn
+void half_draw_interrupt(void) {
+    raise_interrupt(INT_SIGNAL_1);
+}
+
+// Generate this interrupt when screen is fully drawn
+void full_draw_interrupt(void) {
+    raise_interrupt(INT_SIGNAL_2);
+}
+
+void process_shift_register() {
+    static uint16_t reg_shift = 0;
+    uint8_t in = read_port(4);
+    uint8_t offset = read_port(2) & 0x07;
+    uint8_t out = 0;
+
+    reg_shift = (reg_shift >> 8) | ((uint16_t)in << 8);
+    out = (reg_shift >> (8 - offset)) & 0xff;
+
+    write_port(3, out);
+}
+
+// Sounds start when their bit is set. Clearing it only matters for
+// the looping UFO sound, but every edge is reported with the cycle it
+// happened on so the mixer can place it.
+static void trigger_on_edge(bool *previous, bool val, SoundType sound) {
+    if (val != *previous && sound_handler != NULL) {
+        SoundEvent event = { get_cycle_count(), sound, val };
+        sound_handler(event);
+    }
+    *previous = val;
+}
+
+void process_sound() {
+    static bool previous_values[9] = {0};
+
+    trigger_on_edge(&previous_values[0], read_port_bit(3, 1),
+                    SOUND_SHOOT);
+    trigger_on_edge(&previous_values[1], read_port_bit(3, 2),
+                    SOUND_EXPLOSION);
+    trigger_on_edge(&previous_values[2], read_port_bit(3, 3),
+                    SOUND_INVADER_KILLED);
+    trigger_on_edge(&previous_values[3], read_port_bit(5, 0),
+                    SOUND_INVADER_1);
+    trigger_on_edge(&previous_values[4], read_port_bit(5, 1),
+                    SOUND_INVADER_2);
+    trigger_on_edge(&previous_values[5], read_port_bit(5, 2),
+                    SOUND_INVADER_3);
+    trigger_on_edge(&previous_values[6], read_port_bit(5, 3),
+                    SOUND_INVADER_4);
+    trigger_on_edge(&previous_values[7], read_port_bit(3, 0),
+                    SOUND_UFO_LOW);
+    trigger_on_edge(&previous_values[8], read_port_bit(5, 4),
+                    SOUND_UFO_HIGH);
+}
+
+static void latch_inputs(uint8_t inputs) {
+    // CREDIT (1 if deposited)
+    // Port 1 Bit 0
+    write_port_bit(1, 0, (inputs & INPUT_CREDIT) != 0);
+
+    // 1P Start (1 if pressed)
+    // Port 1 Bit 2
+    write_port_bit(1, 2, (inputs & INPUT_1P_START) != 0);
+
+    // 2P Start (1 if pressed)
+    // Port 1 Bit 1
+    write_port_bit(1, 1, (inputs & INPUT_2P_START) != 0);
+
+    // 1P Fire (1 if pressed)
+    // Port 1 Bit 4
+    // 2P Fire (1 if pressed)
+    // Port 2 Bit 4
+    write_port_bit(1, 4, (inputs & INPUT_FIRE) != 0);
+    write_port_bit(2, 4, (inputs & INPUT_FIRE) != 0);
+
+    // 1P Left (1 if pressed)
+    // Port 1 Bit 5
+    // 2P Left (1 if pressed)
+    // Port 2 Bit 5
+    write_port_bit(1, 5, (inputs & INPUT_LEFT) != 0);
+    write_port_bit(2, 5, (inputs & INPUT_LEFT) != 0);
+
+    // 1P Right (1 if pressed)
+    // Port 1 Bit 6
+    // 2P Right (1 if pressed)
+    // Port 2 Bit 6
+    write_port_bit(1, 6, (inputs & INPUT_RIGHT) != 0);
+    write_port_bit(2, 6, (inputs & INPUT_RIGHT) != 0);
+}
+
+static void sample_inputs(uint8_t port) {
+    (void)port;
+    latch_inputs(atomic_load_explicit(&input_snapshot, memory_order_relaxed));
+}
+
+// Safe to call from any thread. The ports are only updated when the
+// game reads them, so it always sees the latest inputs.
+void apply_inputs(uint8_t inputs) {
+    atomic_store_explicit(&input_snapshot, inputs, memory_order_relaxed);
+}
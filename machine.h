@@ -0,0 +1,34 @@
+
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <stdint.h>
+
+#include "audio.h"
+
+// Currently hard coded to run 16,000 cycles per 8 ms slice,
+// with one of the two interrupts generated after each slice
+#define CYCLES_PER_SLICE 16000
+#define SLICE_MS 8
+
+// The emulated clock those numbers add up to
+#define CLOCK_HZ (CYCLES_PER_SLICE * 1000 / SLICE_MS)
+
+// Bits of the input mask passed to apply_inputs
+#define INPUT_CREDIT   0x01
+#define INPUT_1P_START 0x02
+#define INPUT_2P_START 0x04
+#define INPUT_FIRE     0x08
+#define INPUT_LEFT     0x10
+#define INPUT_RIGHT    0x20
+
+void init_machine(char *);
+uint8_t *get_machine_memory(void);
+void set_sound_handler(void (*)(SoundEvent));
+void process_shift_register(void);
+void process_sound(void);
+void apply_inputs(uint8_t);
+void half_draw_interrupt(void);
+void full_draw_interrupt(void);
+
+#endif
@@ -1,261 +1,547 @@
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "SDL.h"
-#include "SDL_mixer.h"
 
 #include "cpu.h"
 #include "display.h"
 #include "audio.h"
-
-static uint8_t memory[65536] = {0};
-
-void load_memory(char *path) {
-    FILE *fp = fopen(path, "rb");
-    
-    if (fp == NULL) {
-        printf("Error opening ROM file\n");
-        exit(1);
+#include "machine.h"
+#include "opstats.h"
+#include "perfstats.h"
+#include "profile.h"
+#include "timeline.h"
+#include "trace.h"
+
+#define FAST_FORWARD_KEY SDL_SCANCODE_TAB
+#define OVERLAY_KEY SDL_SCANCODE_F1
+
+#define STATS_INTERVAL_MS 1000
+// One instruction in STATS_SAMPLE_INTERVAL is timed on its own to split
+// the emulation time between the CPU and the shift register and sound
+#define STATS_SAMPLE_INTERVAL 64
+
+#define MAX_FRAME_SKIP 4
+#define FRAME_SKIP_RECOVERY_FRAMES 30
+
+// How far the left stick has to be pushed to count as left or right
+#define STICK_DEADZONE 8000
+
+// Counts for the current stats interval, times in performance counter
+// ticks. Only touched by the emulation thread.
+typedef struct PerfCounters {
+    Uint64 start_tick;
+    uint64_t start_cycle;
+    uint64_t instr_count;
+    uint64_t fetch_count;
+    uint64_t frame_count;
+    Uint64 emulate_ticks;
+    Uint64 sampled_cpu_ticks;
+    Uint64 sampled_shift_sound_ticks;
+    Uint64 render_ticks;
+} PerfCounters;
+
+typedef struct KeyBinding {
+    int code;
+    uint8_t input;
+} KeyBinding;
+
+static KeyBinding key_bindings[] = {
+    { SDL_SCANCODE_RETURN, INPUT_CREDIT },
+    { SDL_SCANCODE_1, INPUT_1P_START },
+    { SDL_SCANCODE_2, INPUT_2P_START },
+    { SDL_SCANCODE_SPACE, INPUT_FIRE },
+    { SDL_SCANCODE_LEFT, INPUT_LEFT },
+    { SDL_SCANCODE_RIGHT, INPUT_RIGHT }
+};
+
+static KeyBinding button_bindings[] = {
+    { SDL_CONTROLLER_BUTTON_BACK, INPUT_CREDIT },
+    { SDL_CONTROLLER_BUTTON_START, INPUT_1P_START },
+    { SDL_CONTROLLER_BUTTON_Y, INPUT_2P_START },
+    { SDL_CONTROLLER_BUTTON_A, INPUT_FIRE },
+    { SDL_CONTROLLER_BUTTON_DPAD_LEFT, INPUT_LEFT },
+    { SDL_CONTROLLER_BUTTON_DPAD_RIGHT, INPUT_RIGHT }
+};
+
+static atomic_bool is_quitting = false;
+// Held down to run uncapped
+static atomic_bool is_fast_forward = false;
+static int speed = 1;
+
+static bool is_adaptive_skip = false;
+// Frames left undrawn between two drawn ones
+static int frame_skip = 0;
+static int frames_in_budget = 0;
+// Frames adaptive skip left undrawn, not those over the refresh cap
+static uint64_t skipped_frame_count = 0;
+// Full frames the emulation thread has run, for input recordings
+static atomic_uint frame_count = 0;
+
+static PerfCounters counters;
+static PerfStats perf_stats;
+// Time spent presenting, added up by the event thread
+static atomic_uint_fast64_t present_ticks = 0;
+static atomic_bool is_overlay_shown = false;
+static bool is_stats_printed = false;
+// Queried on the event thread, SDL video calls aren't thread safe
+static atomic_int refresh_rate = 0;
+
+static uint8_t key_inputs = 0;
+static uint8_t button_inputs = 0;
+static uint8_t stick_inputs = 0;
+static uint8_t published_inputs = 0;
+static SDL_GameController *controller = NULL;
+static FILE *record_file = NULL;
+
+static uint8_t find_binding(KeyBinding *bindings, int count, int code) {
+    for (int i = 0; i < count; i++) {
+        if (bindings[i].code == code) {
+            return bindings[i].input;
+        }
     }
-
-    memset(memory, 0, sizeof memory);
-    fread(memory, 1, 65536, fp);
-
-    fclose(fp);
+    return 0;
 }
 
-// Generate this interrupt when screen is half way drawn
-void half_draw_interrupt(void) {
-    process_interrupt_signal(INT_SIGNAL_1);
+static void set_input_bits(uint8_t *inputs, uint8_t bits, bool is_down) {
+    if (is_down) {
+        *inputs |= bits;
+    } else {
+        *inputs &= ~bits;
+    }
 }
 
-// Generate this interrupt when screen is fully drawn
-void full_draw_interrupt(void) {
-    process_interrupt_signal(INT_SIGNAL_2);
-}
+// Hands the combined mask to the emulation thread whenever it changes
+// and appends it to the recording in input script format, stamped with
+// the emulated frame and the host time in milliseconds
+static void publish_inputs(void) {
+    uint8_t inputs = key_inputs | button_inputs | stick_inputs;
+
+    if (inputs == published_inputs) {
+        return;
+    }
+    published_inputs = inputs;
+    apply_inputs(inputs);
 
-void process_shift_register() {
-    static uint16_t reg_shift = 0;
-    uint8_t in = read_port(4);
-    uint8_t offset = read_port(2) & 0x07;
-    uint8_t out = 0;
+    if (record_file != NULL) {
+        fprintf(record_file, "%u %02x # %u ms\n", atomic_load(&frame_count),
+                inputs, SDL_GetTicks());
+    }
+}
 
-    reg_shift = (reg_shift >> 8) | ((uint16_t)in << 8);
-    out = (reg_shift >> (8 - offset)) & 0xff;
+static void handle_event(SDL_Event *e) {
+    switch (e->type) {
+        case SDL_QUIT:
+            atomic_store(&is_quitting, true);
+            break;
+        case SDL_WINDOWEVENT:
+            if (e->window.event == SDL_WINDOWEVENT_DISPLAY_CHANGED) {
+                atomic_store(&refresh_rate, get_refresh_rate());
+            }
+            return;
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            if (e->key.keysym.scancode == FAST_FORWARD_KEY) {
+                atomic_store(&is_fast_forward, e->type == SDL_KEYDOWN);
+                return;
+            }
+            if (e->key.keysym.scancode == OVERLAY_KEY) {
+                if (e->type == SDL_KEYDOWN && !e->key.repeat) {
+                    atomic_store(&is_overlay_shown,
+                                 !atomic_load(&is_overlay_shown));
+                }
+                return;
+            }
+            set_input_bits(&key_inputs,
+                           find_binding(key_bindings,
+                                        sizeof key_bindings /
+                                        sizeof key_bindings[0],
+                                        e->key.keysym.scancode),
+                           e->type == SDL_KEYDOWN);
+            break;
+        case SDL_CONTROLLERBUTTONDOWN:
+        case SDL_CONTROLLERBUTTONUP:
+            set_input_bits(&button_inputs,
+                           find_binding(button_bindings,
+                                        sizeof button_bindings /
+                                        sizeof button_bindings[0],
+                                        e->cbutton.button),
+                           e->type == SDL_CONTROLLERBUTTONDOWN);
+            break;
+        case SDL_CONTROLLERAXISMOTION:
+            if (e->caxis.axis == SDL_CONTROLLER_AXIS_LEFTX) {
+                stick_inputs = 0;
+                if (e->caxis.value < -STICK_DEADZONE) {
+                    stick_inputs = INPUT_LEFT;
+                } else if (e->caxis.value > STICK_DEADZONE) {
+                    stick_inputs = INPUT_RIGHT;
+                }
+            }
+            break;
+        case SDL_CONTROLLERDEVICEADDED:
+            // Only the first controller plugged in is used
+            if (controller == NULL) {
+                controller = SDL_GameControllerOpen(e->cdevice.which);
+            }
+            break;
+        case SDL_CONTROLLERDEVICEREMOVED:
+            if (controller != NULL) {
+                SDL_GameControllerClose(controller);
+                controller = NULL;
+                button_inputs = 0;
+                stick_inputs = 0;
+            }
+            break;
+        default:
+            if (e->type == get_frame_event_type()) {
+                Uint64 start = SDL_GetPerformanceCounter();
+                present_frame();
+                atomic_fetch_add(&present_ticks,
+                                 SDL_GetPerformanceCounter() - start);
+            }
+            return;
+    }
 
-    write_port(3, out);
+    publish_inputs();
 }
 
-void process_sound() {
-    static bool previous_values[9] = {0};
-    bool val;
+// Emulation speed as a multiple of real time, 0 runs uncapped
+static int get_speed(void) {
+    return atomic_load(&is_fast_forward) ? 0 : speed;
+}
 
-    val = read_port_bit(3, 1);
-    if (val && !previous_values[0]) {
-        play_sound(SOUND_SHOOT);
+// Sounds are muted away from real time. Stops still go through so that
+// looping sounds end, and the mixer re-anchors on the first sound once
+// the game is back at normal speed.
+static void play_sound_at_speed(SoundEvent event) {
+    if (get_speed() == 1 || !event.is_start) {
+        play_sound(event);
     }
-    previous_values[0] = val;
+}
 
-    val = read_port_bit(3, 2);
-    if (val && !previous_values[1]) {
-        play_sound(SOUND_EXPLOSION);
+// Adaptive frame skip: host time spent on each emulated frame is held
+// against its real time budget. Over budget another frame is skipped
+// between drawn ones, and every FRAME_SKIP_RECOVERY_FRAMES frames in
+// budget one fewer, so drawing comes back gradually once the host
+// catches up. Emulation itself is never skipped.
+static void update_frame_skip(Uint64 frame_ticks, Uint64 budget_ticks) {
+    if (frame_ticks > budget_ticks) {
+        if (frame_skip < MAX_FRAME_SKIP) {
+            frame_skip++;
+        }
+        frames_in_budget = 0;
+    } else if (frame_skip > 0 &&
+               ++frames_in_budget >= FRAME_SKIP_RECOVERY_FRAMES) {
+        frame_skip--;
+        frames_in_budget = 0;
     }
-    previous_values[1] = val;
+}
 
-    val = read_port_bit(3, 3);
-    if (val && !previous_values[2]) {
-        play_sound(SOUND_INVADER_KILLED);
-    }
-    previous_values[2] = val;
+static void run_slice(void) {
+    Instr instr;
+    int cycle_count = 0;
 
-    val = read_port_bit(5, 0);
-    if (val && !previous_values[3]) {
-        play_sound(SOUND_INVADER_1);
-    }
-    previous_values[3] = val;
+    while (cycle_count < CYCLES_PER_SLICE) {
+        if (++counters.fetch_count % STATS_SAMPLE_INTERVAL == 0) {
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            instr = fetch_fused_instr(CYCLES_PER_SLICE - cycle_count);
+            cycle_count += exec_instr(instr);
+            Uint64 t1 = SDL_GetPerformanceCounter();
+            process_shift_register();
+            process_sound();
+            Uint64 t2 = SDL_GetPerformanceCounter();
 
-    val = read_port_bit(5, 1);
-    if (val && !previous_values[4]) {
-        play_sound(SOUND_INVADER_2);
+            counters.sampled_cpu_ticks += t1 - t0;
+            counters.sampled_shift_sound_ticks += t2 - t1;
+        } else {
+            instr = fetch_fused_instr(CYCLES_PER_SLICE - cycle_count);
+            cycle_count += exec_instr(instr);
+            process_shift_register();
+            process_sound();
+        }
+        counters.instr_count += get_guest_instr_count(instr);
     }
-    previous_values[4] = val;
+}
 
-    val = read_port_bit(5, 2);
-    if (val && !previous_values[5]) {
-        play_sound(SOUND_INVADER_3);
-    }
-    previous_values[5] = val;
+static void reset_perf_counters(Uint64 now) {
+    memset(&counters, 0, sizeof counters);
+    counters.start_tick = now;
+    counters.start_cycle = get_cycle_count();
+}
 
-    val = read_port_bit(5, 3);
-    if (val && !previous_values[6]) {
-        play_sound(SOUND_INVADER_4);
-    }
-    previous_values[6] = val;
+// Called once per emulated frame, turns the counters into PerfStats
+// every STATS_INTERVAL_MS for the overlay and the JSON lines
+static void update_perf_stats(Uint64 now, Uint64 tick_rate) {
+    Uint64 elapsed = now - counters.start_tick;
 
-    val = read_port_bit(3, 0);
-    if (val && !previous_values[7]) {
-        play_sound(SOUND_UFO_LOW);
+    counters.frame_count++;
+    if (elapsed < tick_rate * STATS_INTERVAL_MS / 1000) {
+        return;
     }
-    previous_values[7] = val;
 
-    val = read_port_bit(5, 4);
-    if (val && !previous_values[8]) {
-        play_sound(SOUND_UFO_HIGH);
+    double seconds = (double)elapsed / tick_rate;
+    double ms_per_frame_tick = 1000.0 / tick_rate / counters.frame_count;
+    Uint64 sampled = counters.sampled_cpu_ticks +
+                     counters.sampled_shift_sound_ticks;
+    double cpu_share = sampled == 0 ? 1.0 :
+                       (double)counters.sampled_cpu_ticks / sampled;
+
+    perf_stats.emulated_mhz = (get_cycle_count() - counters.start_cycle) /
+                              seconds / 1e6;
+    perf_stats.instrs_per_sec = counters.instr_count / seconds;
+    perf_stats.cpu_ms = counters.emulate_ticks * cpu_share *
+                        ms_per_frame_tick;
+    perf_stats.shift_sound_ms = counters.emulate_ticks * (1 - cpu_share) *
+                                ms_per_frame_tick;
+    perf_stats.render_ms = counters.render_ticks * ms_per_frame_tick;
+    perf_stats.present_ms = atomic_exchange(&present_ticks, 0) *
+                            ms_per_frame_tick;
+    perf_stats.frame_count = atomic_load(&frame_count);
+    perf_stats.skipped_frame_count = skipped_frame_count;
+
+    if (is_stats_printed) {
+        write_perf_stats(&perf_stats, stdout);
     }
-    previous_values[8] = val;
+    reset_perf_counters(now);
 }
 
-void set_dip_switches() {
-    // bit 0 = DIP3
-    // bit 1 = DIP5
-    // bits 1 & 0
-    //   00 = 3 ships
-    //   01 = 4 ships
-    //   10 = 5 ships
-    //   11 = 6 ships
-    write_port_bit(2, 0, 1);
-    write_port_bit(2, 1, 1);
-
-    // bit 3 = DIP6
-    // 0 = extra ship at 1500
-    // 1 = extra ship at 1000
-    write_port_bit(2, 3, 1);
-
-    // bit 7 = DIP7
-    // 0 = display coin info on demo screen
-    // 1 = don't display coin info on demo screen
-    write_port_bit(2, 7, 0);
-}
+// Runs the machine on a thread of its own, so it never waits on the
+// window system. Inputs come in through apply_inputs and finished
+// frames go out through render_frame. Interrupts are tied to emulated
+// cycles, so at any speed the game sees the same 2 per 32,000 cycles.
+// `arg` points to the display refresh rate the event thread keeps up
+// to date.
+static void *run_emulation(void *arg) {
+    atomic_int *display_rate = arg;
+    Uint64 tick_rate = SDL_GetPerformanceFrequency();
+    Uint64 slice_ticks = tick_rate * SLICE_MS / 1000;
+    Uint64 deadline = SDL_GetPerformanceCounter();
+    Uint64 frame_work_ticks = 0;
+    Uint64 last_render = 0;
+    int frames_since_render = 0;
+    bool interrupt_flip_flop = false;
 
-void handle_inputs() {
-    SDL_PumpEvents();
-    const Uint8 *state = SDL_GetKeyboardState(NULL);
+    name_timeline_thread("emulation");
+    reset_perf_counters(deadline);
 
-    // CREDIT (1 if deposited)
-    // Port 1 Bit 0
-    if (state[SDL_SCANCODE_RETURN]) {
-        write_port_bit(1, 0, 1);
-    } else {
-        write_port_bit(1, 0, 0);
-    }
+    while (!atomic_load(&is_quitting)) {
+        int current_speed = get_speed();
+        Uint64 slice_start = SDL_GetPerformanceCounter();
+        uint64_t phase_start = begin_timeline_event();
 
-    // 1P Start (1 if pressed)
-    // Port 1 Bit 2
-    if (state[SDL_SCANCODE_1]) {
-        write_port_bit(1, 2, 1);
-    } else {
-        write_port_bit(1, 2, 0);
-    }
+        run_slice();
+        counters.emulate_ticks += SDL_GetPerformanceCounter() - slice_start;
+        end_timeline_event("emulate", phase_start);
 
-    // 2P Start (1 if pressed)
-    // Port 1 Bit 1
-    if (state[SDL_SCANCODE_2]) {
-        write_port_bit(1, 1, 1);
-    } else {
-        write_port_bit(1, 1, 0);
-    }
+        interrupt_flip_flop = !interrupt_flip_flop;
 
-    // 1P Fire (1 if pressed)
-    // Port 1 Bit 4
-    // 2P Fire (1 if pressed)
-    // Port 2 Bit 4
-    if (state[SDL_SCANCODE_SPACE]) {
-        write_port_bit(1, 4, 1);
-        write_port_bit(2, 4, 1);
-    } else {
-        write_port_bit(1, 4, 0);
-        write_port_bit(2, 4, 0);
-    }
+        if (interrupt_flip_flop) {
+            phase_start = begin_timeline_event();
+            half_draw_interrupt();
+            end_timeline_event("interrupt", phase_start);
+        } else {
+            // Faster than real time frames are only drawn as often as
+            // the display can show them
+            Uint64 now = SDL_GetPerformanceCounter();
+            Uint64 frame_interval_ticks = tick_rate /
+                                          atomic_load(display_rate);
+            bool is_due = current_speed == 1 ||
+                          now - last_render >= frame_interval_ticks;
+            bool is_drawn = is_due;
+            if (is_adaptive_skip) {
+                // A frame still waiting to be presented means the
+                // presenting thread is stalled as well
+                is_drawn = is_due && frames_since_render >= frame_skip &&
+                           !is_frame_pending();
+            }
 
-    // 1P Left (1 if pressed)
-    // Port 1 Bit 5
-    // 2P Left (1 if pressed)
-    // Port 2 Bit 5
-    if (state[SDL_SCANCODE_LEFT]) {
-        write_port_bit(1, 5, 1);
-        write_port_bit(2, 5, 1);
-    } else {
-        write_port_bit(1, 5, 0);
-        write_port_bit(2, 5, 0);
-    }
+            if (is_drawn) {
+                phase_start = begin_timeline_event();
+                render_frame(atomic_load(&is_overlay_shown) ?
+                             &perf_stats : NULL);
+                counters.render_ticks += SDL_GetPerformanceCounter() - now;
+                end_timeline_event("render", phase_start);
+                last_render = now;
+                frames_since_render = 0;
+            } else {
+                frames_since_render++;
+                skipped_frame_count += is_due;
+            }
+            phase_start = begin_timeline_event();
+            full_draw_interrupt();
+            end_timeline_event("interrupt", phase_start);
+            atomic_fetch_add(&frame_count, 1);
+        }
 
-    // 1P Right (1 if pressed)
-    // Port 1 Bit 6
-    // 2P Right (1 if pressed)
-    // Port 2 Bit 6
-    if (state[SDL_SCANCODE_RIGHT]) {
-        write_port_bit(1, 6, 1);
-        write_port_bit(2, 6, 1);
-    } else {
-        write_port_bit(1, 6, 0);
-        write_port_bit(2, 6, 0);
+        // Slices are paced against a running deadline rather than their
+        // own start, so time lost to rounding the delay to milliseconds
+        // is made up on the next slice
+        Uint64 now = SDL_GetPerformanceCounter();
+        frame_work_ticks += now - slice_start;
+        if (!interrupt_flip_flop) {
+            update_perf_stats(now, tick_rate);
+            if (is_adaptive_skip && current_speed != 0) {
+                update_frame_skip(frame_work_ticks,
+                                  2 * slice_ticks / current_speed);
+            }
+            frame_work_ticks = 0;
+        }
+        if (current_speed == 0) {
+            deadline = now;
+        } else {
+            deadline += slice_ticks / current_speed;
+            if (now < deadline) {
+                phase_start = begin_timeline_event();
+                SDL_Delay((deadline - now) * 1000 / tick_rate);
+                end_timeline_event("delay", phase_start);
+            } else if (now - deadline > slice_ticks) {
+                // Too far behind to catch up without a burst
+                deadline = now;
+            }
+        }
+        // TODO: handle outputs
     }
+
+    return NULL;
 }
 
 int main(int argc, char *argv[]) {
+    char *trace_path = NULL;
+    char *profile_prefix = NULL;
+    char *symbol_path = NULL;
+    char *stats_path = NULL;
+    char *record_path = NULL;
+    char *timeline_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:p:s:m:r:c:x:fjdh")) != -1) {
+        switch (opt) {
+            case 't':
+                trace_path = optarg;
+                break;
+            case 'p':
+                profile_prefix = optarg;
+                break;
+            case 's':
+                symbol_path = optarg;
+                break;
+            case 'm':
+                stats_path = optarg;
+                break;
+            case 'r':
+                record_path = optarg;
+                break;
+            case 'c':
+                timeline_path = optarg;
+                break;
+            case 'x':
+                speed = atoi(optarg);
+                break;
+            case 'f':
+                is_adaptive_skip = true;
+                break;
+            case 'j':
+                is_stats_printed = true;
+                break;
+            case 'd':
+                atomic_store(&is_overlay_shown, true);
+                break;
+            default:
+                printf("Usage: %s [-t trace_file] [-p profile_prefix] "
+                       "[-s symbol_file] [-m opcode_stats] "
+                       "[-r input_record] [-c timeline_file] [-x speed] "
+                       "[-f] [-j] [-d]\n",
+                       argv[0]);
+                exit(opt == 'h' ? 0 : 1);
+        }
+    }
 
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
-        printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+    if (speed < 0) {
+        printf("Speed must be 0 (uncapped) or a multiple of real time\n");
+        exit(1);
+    }
+#ifndef CPU_PROFILE
+    if (profile_prefix != NULL) {
+        printf("Profiling needs a build with -DCPU_PROFILE\n");
+        exit(1);
+    }
+#endif
+#ifndef CPU_OPCODE_STATS
+    if (stats_path != NULL) {
+        printf("Opcode statistics need a build with -DCPU_OPCODE_STATS\n");
+        exit(1);
+    }
+#endif
+    if (symbol_path != NULL && !load_profile_symbols(symbol_path)) {
         exit(1);
     }
 
-    if (Mix_OpenAudio(22050, MIX_DEFAULT_FORMAT, 2, 4096) < 0) {
-        printf("SDL Mixer could not initialize!\n");
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO |
+                 SDL_INIT_GAMECONTROLLER) < 0) {
+        printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
         exit(1);
     }
 
-    bool quit = false;
     SDL_Event e;
+    pthread_t emulation_thread;
 
-    Uint32 start_tick_time;
-    Uint32 elapsed_tick_time;
-    bool interrupt_flip_flop = false;
+    if (record_path != NULL) {
+        record_file = fopen(record_path, "w");
+        if (record_file == NULL) {
+            printf("Error opening input recording %s\n", record_path);
+            exit(1);
+        }
+        fprintf(record_file, "# <frame> <input mask> # <host time>\n");
+    }
 
-    Instr instr;
+    if (timeline_path != NULL && !start_timeline(timeline_path)) {
+        exit(1);
+    }
+    name_timeline_thread("events");
 
-    load_memory("invaders.rom");
-    init_cpu(memory);
-    init_display(memory);
+    init_machine("invaders.rom");
+    init_display(get_machine_memory());
     init_audio();
-    set_dip_switches();
-
-    while (!quit) {
-        // TODO: improve timing mechanism
-        // Currently hard coded to run loop every 8 ms
-        // Runs 16,000 cycles in this time
-        // Executes one of the two interrupts
-        // Updates display every other loop
-        while (SDL_PollEvent(&e) != 0) {
-            if (e.type == SDL_QUIT) {
-                quit = true;
-            }
-        }
-
-        start_tick_time = SDL_GetTicks();
+    set_sound_handler(play_sound_at_speed);
 
-        int cycle_count = 0;
-        while (cycle_count < 16000) {
-            instr = fetch_instr();
-            cycle_count += exec_instr(instr);
-            process_shift_register();
-            process_sound();
-        }
+    // Records are dropped rather than slowing the game down
+    if (trace_path != NULL && !start_trace(trace_path, false)) {
+        exit(1);
+    }
 
-        interrupt_flip_flop = !interrupt_flip_flop;
-        
-        if (interrupt_flip_flop) {
-            half_draw_interrupt();
-        } else {
-            update_display();
-            full_draw_interrupt();
-        }
+    atomic_store(&refresh_rate, get_refresh_rate());
+    pthread_create(&emulation_thread, NULL, run_emulation, &refresh_rate);
+
+    // SDL wants events handled on the thread that made the window, so
+    // this one sleeps here until a key, a controller or a finished frame
+    // wakes it up
+    while (!atomic_load(&is_quitting) && SDL_WaitEvent(&e)) {
+        uint64_t event_start = begin_timeline_event();
+        handle_event(&e);
+        end_timeline_event(e.type == get_frame_event_type() ? "present" :
+                           "input", event_start);
+    }
+    atomic_store(&is_quitting, true);
+    pthread_join(emulation_thread, NULL);
+    stop_timeline();
 
-        elapsed_tick_time = SDL_GetTicks() - start_tick_time;
-        if (elapsed_tick_time < 8) {
-            SDL_Delay(8 - elapsed_tick_time);
-        }
-        handle_inputs();
-        // TODO: handle outputs
+    if (record_file != NULL) {
+        fclose(record_file);
+    }
+    // stdout carries the JSON stream under -j, keep it parseable
+    fprintf(is_stats_printed ? stderr : stdout,
+            "Frames: %u, skipped: %llu\n", atomic_load(&frame_count),
+            (unsigned long long)skipped_frame_count);
+    stop_trace();
+    if (profile_prefix != NULL) {
+        write_profile(profile_prefix);
+    }
+    if (stats_path != NULL) {
+        save_opcode_stats(stats_path);
     }
 }
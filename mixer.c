@@ -0,0 +1,395 @@
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mixer.h"
+
+#ifdef EMBED_ASSETS
+#include "assets.h"
+#endif
+
+typedef struct Voice {
+    const Sound *sound;
+    uint32_t position;
+} Voice;
+
+// An event moved from emulated cycles to a position in the output
+typedef struct ScheduledEvent {
+    uint64_t sample;
+    uint8_t sound;
+    bool is_start;
+} ScheduledEvent;
+
+// Single producer (the emulation thread), single consumer (the audio
+// callback) queue of sound events. head and tail only ever increase
+// and are masked when indexing.
+typedef struct SoundQueue {
+    SoundEvent events[SOUND_QUEUE_SIZE];
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+} SoundQueue;
+
+static char *sound_paths[SOUND_COUNT] = {
+    [SOUND_SHOOT] = "sounds/shoot.wav",
+    [SOUND_INVADER_1] = "sounds/fastinvader1.wav",
+    [SOUND_INVADER_2] = "sounds/fastinvader2.wav",
+    [SOUND_INVADER_3] = "sounds/fastinvader3.wav",
+    [SOUND_INVADER_4] = "sounds/fastinvader4.wav",
+    [SOUND_INVADER_KILLED] = "sounds/invaderkilled.wav",
+    [SOUND_EXPLOSION] = "sounds/explosion.wav",
+    [SOUND_UFO_HIGH] = "sounds/ufo_highpitch.wav",
+    [SOUND_UFO_LOW] = "sounds/ufo_lowpitch.wav"
+};
+
+static int mixer_rate = 0;
+static int clock_rate = 0;
+static Sound sounds[SOUND_COUNT];
+static atomic_bool are_sounds_loaded = false;
+static SoundQueue queue;
+
+// The rest is only touched by the audio callback
+static Voice voices[MAX_VOICES];
+
+// Events taken off the queue but not due yet, in order
+static ScheduledEvent scheduled[SOUND_QUEUE_SIZE];
+static uint32_t scheduled_head = 0;
+static uint32_t scheduled_tail = 0;
+
+// Samples written so far
+static uint64_t stream_position = 0;
+
+// Output sample minus emulated sample for events, fixed on the first
+// event and again whenever emulation stalls or runs ahead
+static int64_t sample_offset = 0;
+static bool is_offset_set = false;
+static bool is_offset_locked = false;
+
+// `clock_hz` is the emulated CPU clock the event cycles count
+void init_mixer(int sample_rate, int clock_hz) {
+    for (int i = 0; i < SOUND_COUNT; i++) {
+        free(sounds[i].samples);
+    }
+    memset(sounds, 0, sizeof sounds);
+    atomic_store(&are_sounds_loaded, false);
+    memset(voices, 0, sizeof voices);
+    atomic_store(&queue.head, 0);
+    atomic_store(&queue.tail, 0);
+    scheduled_head = 0;
+    scheduled_tail = 0;
+    stream_position = 0;
+    is_offset_set = false;
+    is_offset_locked = false;
+    mixer_rate = sample_rate;
+    clock_rate = clock_hz;
+}
+
+// For rendering offline, where the output is produced in step with
+// emulation: output sample n is emulated sample n, with no latency and
+// no resyncing
+void lock_mixer_to_cycles() {
+    sample_offset = 0;
+    is_offset_set = true;
+    is_offset_locked = true;
+}
+
+static uint32_t read_le32(const uint8_t *bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+           ((uint32_t)bytes[3] << 24);
+}
+
+static uint16_t read_le16(const uint8_t *bytes) {
+    return bytes[0] | (bytes[1] << 8);
+}
+
+static uint8_t *read_file(char *path, size_t *size) {
+    FILE *fp = fopen(path, "rb");
+    uint8_t *data;
+
+    if (fp == NULL) {
+        printf("Error opening sound file %s\n", path);
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    rewind(fp);
+
+    data = malloc(*size);
+    if (fread(data, 1, *size, fp) != *size) {
+        printf("Error reading sound file %s\n", path);
+        free(data);
+        data = NULL;
+    }
+
+    fclose(fp);
+    return data;
+}
+
+// Linear interpolation from `rate` to the mixer rate
+static void resample(const int16_t *in, uint32_t length, int rate,
+                     Sound *sound) {
+    sound->length = (uint64_t)length * mixer_rate / rate;
+    sound->samples = malloc(sound->length * sizeof(int16_t));
+
+    for (uint32_t i = 0; i < sound->length; i++) {
+        // Source position in 16.16 fixed point
+        uint64_t position = ((uint64_t)i * rate << 16) / mixer_rate;
+        uint32_t index = position >> 16;
+        int32_t fraction = position & 0xffff;
+        int32_t first = in[index];
+        int32_t second = index + 1 < length ? in[index + 1] : first;
+
+        sound->samples[i] = first + (((second - first) * fraction) >> 16);
+    }
+}
+
+// Accepts uncompressed mono WAVs with 8-bit unsigned or 16-bit signed
+// samples at any rate, which covers everything in sounds/. Returns the
+// samples as signed 16-bit at the file's rate, to be freed by the
+// caller.
+bool decode_wav(char *path, int16_t **pcm, uint32_t *pcm_length,
+                uint32_t *pcm_rate) {
+    size_t size;
+    uint8_t *data = read_file(path, &size);
+    uint8_t *fmt = NULL;
+    uint8_t *samples = NULL;
+    uint32_t data_size = 0;
+
+    if (data == NULL) {
+        return false;
+    }
+
+    if (size < 12 || memcmp(data, "RIFF", 4) != 0 ||
+        memcmp(data + 8, "WAVE", 4) != 0) {
+        printf("Error: %s is not a WAV file\n", path);
+        free(data);
+        return false;
+    }
+
+    // Chunks are padded to an even length
+    for (size_t offset = 12; offset + 8 <= size;) {
+        uint32_t chunk_size = read_le32(data + offset + 4);
+        if (chunk_size > size - offset - 8) {
+            chunk_size = size - offset - 8;
+        }
+
+        if (memcmp(data + offset, "fmt ", 4) == 0 && chunk_size >= 16) {
+            fmt = data + offset + 8;
+        } else if (memcmp(data + offset, "data", 4) == 0) {
+            samples = data + offset + 8;
+            data_size = chunk_size;
+        }
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    if (fmt == NULL || samples == NULL) {
+        printf("Error: %s has no format or data chunk\n", path);
+        free(data);
+        return false;
+    }
+
+    uint16_t format = read_le16(fmt);
+    uint16_t channels = read_le16(fmt + 2);
+    uint32_t rate = read_le32(fmt + 4);
+    uint16_t bits = read_le16(fmt + 14);
+
+    if (format != 1 || channels != 1 || (bits != 8 && bits != 16) ||
+        rate == 0) {
+        printf("Error: %s is not 8 or 16-bit mono PCM\n", path);
+        free(data);
+        return false;
+    }
+
+    uint32_t length = data_size / (bits / 8);
+    int16_t *decoded = malloc((length > 0 ? length : 1) * sizeof(int16_t));
+    for (uint32_t i = 0; i < length; i++) {
+        if (bits == 8) {
+            decoded[i] = (int16_t)((samples[i] - 128) * 256);
+        } else {
+            decoded[i] = (int16_t)read_le16(samples + i * 2);
+        }
+    }
+
+    *pcm = decoded;
+    *pcm_length = length;
+    *pcm_rate = rate;
+    free(data);
+    return true;
+}
+
+// Takes signed 16-bit samples at `rate` and keeps a copy resampled to
+// the mixer rate
+void set_sound(SoundType type, const int16_t *pcm, uint32_t length,
+               uint32_t rate, bool is_looping) {
+    free(sounds[type].samples);
+    resample(pcm, length, rate, &sounds[type]);
+    sounds[type].is_looping = is_looping;
+}
+
+bool load_sound(SoundType type, char *path, bool is_looping) {
+    int16_t *pcm;
+    uint32_t length;
+    uint32_t rate;
+
+    if (!decode_wav(path, &pcm, &length, &rate)) {
+        return false;
+    }
+
+    set_sound(type, pcm, length, rate, is_looping);
+    free(pcm);
+    return true;
+}
+
+char *get_sound_path(SoundType type) {
+    return sound_paths[type];
+}
+
+// Loads every game sound, the UFO sound loops for as long as its port
+// bit stays set. The mixer plays silence until this is done, so it can
+// run on another thread while the audio device is already running.
+bool load_sounds() {
+    for (int i = 0; i < SOUND_COUNT; i++) {
+#ifdef EMBED_ASSETS
+        set_sound(i, embedded_sounds[i].samples, embedded_sounds[i].length,
+                  embedded_sounds[i].rate, i == SOUND_UFO_LOW);
+#else
+        if (!load_sound(i, sound_paths[i], i == SOUND_UFO_LOW)) {
+            return false;
+        }
+#endif
+    }
+
+    atomic_store_explicit(&are_sounds_loaded, true, memory_order_release);
+    return true;
+}
+
+// Called from the emulation thread. Drops the event if the audio
+// callback has fallen that far behind.
+void queue_sound(SoundEvent event) {
+    uint32_t head = atomic_load_explicit(&queue.head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&queue.tail, memory_order_acquire);
+
+    if (head - tail == SOUND_QUEUE_SIZE) {
+        return;
+    }
+
+    queue.events[head & (SOUND_QUEUE_SIZE - 1)] = event;
+    atomic_store_explicit(&queue.head, head + 1, memory_order_release);
+}
+
+// Places events SOUND_LATENCY_MS after the current output position,
+// keeping their spacing in emulated time. If an event would land in
+// the past or too far ahead, emulation and audio have drifted apart
+// and the offset starts over from that event.
+static void schedule_queued_events() {
+    uint32_t tail = atomic_load_explicit(&queue.tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue.head, memory_order_acquire);
+    int64_t latency = (int64_t)mixer_rate * SOUND_LATENCY_MS / 1000;
+
+    for (; tail != head; tail++) {
+        SoundEvent *event = &queue.events[tail & (SOUND_QUEUE_SIZE - 1)];
+        int64_t emulated = event->cycle * mixer_rate / clock_rate;
+        int64_t sample = emulated + sample_offset;
+
+        if (scheduled_head - scheduled_tail == SOUND_QUEUE_SIZE) {
+            break;
+        }
+
+        if (!is_offset_set ||
+            (!is_offset_locked &&
+             (sample < (int64_t)stream_position ||
+              sample > (int64_t)stream_position + 4 * latency))) {
+            sample_offset = stream_position + latency - emulated;
+            sample = stream_position + latency;
+            is_offset_set = true;
+        }
+
+        ScheduledEvent *scheduled_event =
+            &scheduled[scheduled_head++ & (SOUND_QUEUE_SIZE - 1)];
+        scheduled_event->sample = sample;
+        scheduled_event->sound = event->sound;
+        scheduled_event->is_start = event->is_start;
+    }
+
+    atomic_store_explicit(&queue.tail, tail, memory_order_release);
+}
+
+static void apply_event(ScheduledEvent *event) {
+    const Sound *sound = &sounds[event->sound];
+
+    // Stopping only ends looping sounds, and a looping sound that is
+    // already playing isn't started twice
+    for (int i = 0; i < MAX_VOICES; i++) {
+        if (voices[i].sound == sound && sound->is_looping) {
+            if (!event->is_start) {
+                voices[i].sound = NULL;
+            }
+            return;
+        }
+    }
+
+    if (!event->is_start || sound->length == 0) {
+        return;
+    }
+
+    for (int i = 0; i < MAX_VOICES; i++) {
+        if (voices[i].sound == NULL) {
+            voices[i].sound = sound;
+            voices[i].position = 0;
+            return;
+        }
+    }
+}
+
+// Called from the audio callback, fills `out` with `count` samples
+void mix_sounds(int16_t *out, int count) {
+    // Events wait in the queue until there is something to play
+    if (!atomic_load_explicit(&are_sounds_loaded, memory_order_acquire)) {
+        memset(out, 0, count * sizeof(int16_t));
+        stream_position += count;
+        return;
+    }
+
+    schedule_queued_events();
+
+    for (int i = 0; i < count; i++) {
+        int32_t sum = 0;
+
+        while (scheduled_tail != scheduled_head) {
+            ScheduledEvent *event =
+                &scheduled[scheduled_tail & (SOUND_QUEUE_SIZE - 1)];
+            if (event->sample > stream_position) {
+                break;
+            }
+            apply_event(event);
+            scheduled_tail++;
+        }
+
+        for (int j = 0; j < MAX_VOICES; j++) {
+            Voice *voice = &voices[j];
+            if (voice->sound == NULL) {
+                continue;
+            }
+            sum += voice->sound->samples[voice->position++];
+            if (voice->position == voice->sound->length) {
+                if (voice->sound->is_looping) {
+                    voice->position = 0;
+                } else {
+                    voice->sound = NULL;
+                }
+            }
+        }
+
+        if (sum > INT16_MAX) {
+            sum = INT16_MAX;
+        } else if (sum < INT16_MIN) {
+            sum = INT16_MIN;
+        }
+        out[i] = sum;
+        stream_position++;
+    }
+}
@@ -0,0 +1,40 @@
+
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio.h"
+
+// Must be a power of two
+#define SOUND_QUEUE_SIZE 64
+
+// Sounds that can play at once, further triggers are dropped
+#define MAX_VOICES 16
+
+// How far behind emulated time sounds play. Events for a whole slice
+// arrive in one burst and the callback takes them a buffer at a time,
+// so this has to cover a slice plus an audio buffer to keep the
+// spacing between them exact.
+#define SOUND_LATENCY_MS 30
+
+// Signed 16-bit mono at the mixer's sample rate
+typedef struct Sound {
+    int16_t *samples;
+    uint32_t length;
+    // Repeats until stopped instead of playing once
+    bool is_looping;
+} Sound;
+
+void init_mixer(int, int);
+void lock_mixer_to_cycles(void);
+bool decode_wav(char *, int16_t **, uint32_t *, uint32_t *);
+void set_sound(SoundType, const int16_t *, uint32_t, uint32_t, bool);
+bool load_sound(SoundType, char *, bool);
+bool load_sounds(void);
+char *get_sound_path(SoundType);
+void queue_sound(SoundEvent);
+void mix_sounds(int16_t *, int);
+
+#endif
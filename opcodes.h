@@ -0,0 +1,272 @@
+
+#ifndef OPCODES_H
+#define OPCODES_H
+
+// Every 8080 opcode, in order. This one list drives the decode table,
+// the handlers in exec_instr() and the disassembly table.
+//
+// X(opcode, type, dst, src, mnemonic, registers, cycles, bytes)
+//
+// type     InstrType without the INSTR_ prefix, selects the handler
+// dst/src  register operands: B C D E H L M A, the pairs BC DE HL SP
+//          PSW, or NONE. Single register instructions use dst.
+// cycles   for conditional CALL/RET, the cycles when not taken
+#define FOR_EACH_OPCODE(X) \
+    X(0x00, NOP, NONE, NONE, "NOP", "", 4, 1)                            \
+    X(0x01, LOAD_REG_PAIR_IMMEDIATE, BC, NONE, "LXI", "B", 10, 3)        \
+    X(0x02, STORE_ACCUMULATOR, BC, NONE, "STAX", "B", 7, 1)              \
+    X(0x03, INCREMENT_REG_PAIR, BC, NONE, "INX", "B", 5, 1)              \
+    X(0x04, INCREMENT_REG, B, NONE, "INR", "B", 5, 1)                    \
+    X(0x05, DECREMENT_REG, B, NONE, "DCR", "B", 5, 1)                    \
+    X(0x06, MOVE_IMMEDIATE, B, NONE, "MVI", "B", 7, 2)                   \
+    X(0x07, ROTATE_ACCUMULATOR_LEFT, NONE, NONE, "RLC", "", 4, 1)        \
+    X(0x08, NOP, NONE, NONE, "NOP", "", 4, 1)                            \
+    X(0x09, DOUBLE_ADD, BC, NONE, "DAD", "B", 10, 1)                     \
+    X(0x0a, LOAD_ACCUMULATOR, BC, NONE, "LDAX", "B", 7, 1)               \
+    X(0x0b, DECREMENT_REG_PAIR, BC, NONE, "DCX", "B", 5, 1)              \
+    X(0x0c, INCREMENT_REG, C, NONE, "INR", "C", 5, 1)                    \
+    X(0x0d, DECREMENT_REG, C, NONE, "DCR", "C", 5, 1)                    \
+    X(0x0e, MOVE_IMMEDIATE, C, NONE, "MVI", "C", 7, 2)                   \
+    X(0x0f, ROTATE_ACCUMULATOR_RIGHT, NONE, NONE, "RRC", "", 4, 1)       \
+    X(0x10, NOP, NONE, NONE, "NOP", "", 4, 1)                            \
+    X(0x11, LOAD_REG_PAIR_IMMEDIATE, DE, NONE, "LXI", "D", 10, 3)        \
+    X(0x12, STORE_ACCUMULATOR, DE, NONE, "STAX", "D", 7, 1)              \
+    X(0x13, INCREMENT_REG_PAIR, DE, NONE, "INX", "D", 5, 1)              \
+    X(0x14, INCREMENT_REG, D, NONE, "INR", "D", 5, 1)                    \
+    X(0x15, DECREMENT_REG, D, NONE, "DCR", "D", 5, 1)                    \
+    X(0x16, MOVE_IMMEDIATE, D, NONE, "MVI", "D", 7, 2)                   \
+    X(0x17, ROTATE_ACCUMULATOR_LEFT_CARRY, NONE, NONE, "RAL", "", 4, 1)  \
+    X(0x18, NOP, NONE, NONE, "NOP", "", 4, 1)                            \
+    X(0x19, DOUBLE_ADD, DE, NONE, "DAD", "D", 10, 1)                     \
+    X(0x1a, LOAD_ACCUMULATOR, DE, NONE, "LDAX", "D", 7, 1)               \
+    X(0x1b, DECREMENT_REG_PAIR, DE, NONE, "DCX", "D", 5, 1)              \
+    X(0x1c, INCREMENT_REG, E, NONE, "INR", "E", 5, 1)                    \
+    X(0x1d, DECREMENT_REG, E, NONE, "DCR", "E", 5, 1)                    \
+    X(0x1e, MOVE_IMMEDIATE, E, NONE, "MVI", "E", 7, 2)                   \
+    X(0x1f, ROTATE_ACCUMULATOR_RIGHT_CARRY, NONE, NONE, "RAR", "", 4, 1) \
+    X(0x20, NOP, NONE, NONE, "NOP", "", 4, 1)                            \
+    X(0x21, LOAD_REG_PAIR_IMMEDIATE, HL, NONE, "LXI", "H", 10, 3)        \
+    X(0x22, STORE_HL_DIRECT, NONE, NONE, "SHLD", "", 16, 3)              \
+    X(0x23, INCREMENT_REG_PAIR, HL, NONE, "INX", "H", 5, 1)              \
+    X(0x24, INCREMENT_REG, H, NONE, "INR", "H", 5, 1)                    \
+    X(0x25, DECREMENT_REG, H, NONE, "DCR", "H", 5, 1)                    \
+    X(0x26, MOVE_IMMEDIATE, H, NONE, "MVI", "H", 7, 2)                   \
+    X(0x27, DECIMAL_ADJUST_ACCUMULATOR, NONE, NONE, "DAA", "", 4, 1)     \
+    X(0x28, NOP, NONE, NONE, "NOP", "", 4, 1)                            \
+    X(0x29, DOUBLE_ADD, HL, NONE, "DAD", "H", 10, 1)                     \
+    X(0x2a, LOAD_HL_DIRECT, NONE, NONE, "LHLD", "", 16, 3)               \
+    X(0x2b, DECREMENT_REG_PAIR, HL, NONE, "DCX", "H", 5, 1)              \
+    X(0x2c, INCREMENT_REG, L, NONE, "INR", "L", 5, 1)                    \
+    X(0x2d, DECREMENT_REG, L, NONE, "DCR", "L", 5, 1)                    \
+    X(0x2e, MOVE_IMMEDIATE, L, NONE, "MVI", "L", 7, 2)                   \
+    X(0x2f, COMPLEMENT_ACCUMULATOR, NONE, NONE, "CMA", "", 4, 1)         \
+    X(0x30, NOP, NONE, NONE, "NOP", "", 4, 1)                            \
+    X(0x31, LOAD_REG_PAIR_IMMEDIATE, SP, NONE, "LXI", "SP", 10, 3)       \
+    X(0x32, STORE_ACCUMULATOR_DIRECT, NONE, NONE, "STA", "", 13, 3)      \
+    X(0x33, INCREMENT_REG_PAIR, SP, NONE, "INX", "SP", 5, 1)             \
+    X(0x34, INCREMENT_REG, M, NONE, "INR", "M", 10, 1)                   \
+    X(0x35, DECREMENT_REG, M, NONE, "DCR", "M", 10, 1)                   \
+    X(0x36, MOVE_IMMEDIATE, M, NONE, "MVI", "M", 10, 2)                  \
+    X(0x37, SET_CARRY, NONE, NONE, "STC", "", 4, 1)                      \
+    X(0x38, NOP, NONE, NONE, "NOP", "", 4, 1)                            \
+    X(0x39, DOUBLE_ADD, SP, NONE, "DAD", "SP", 10, 1)                    \
+    X(0x3a, LOAD_ACCUMULATOR_DIRECT, NONE, NONE, "LDA", "", 13, 3)       \
+    X(0x3b, DECREMENT_REG_PAIR, SP, NONE, "DCX", "SP", 5, 1)             \
+    X(0x3c, INCREMENT_REG, A, NONE, "INR", "A", 5, 1)                    \
+    X(0x3d, DECREMENT_REG, A, NONE, "DCR", "A", 5, 1)                    \
+    X(0x3e, MOVE_IMMEDIATE, A, NONE, "MVI", "A", 7, 2)                   \
+    X(0x3f, COMPLEMENT_CARRY, NONE, NONE, "CMC", "", 4, 1)               \
+    X(0x40, MOVE, B, B, "MOV", "B,B", 5, 1)                              \
+    X(0x41, MOVE, B, C, "MOV", "B,C", 5, 1)                              \
+    X(0x42, MOVE, B, D, "MOV", "B,D", 5, 1)                              \
+    X(0x43, MOVE, B, E, "MOV", "B,E", 5, 1)                              \
+    X(0x44, MOVE, B, H, "MOV", "B,H", 5, 1)                              \
+    X(0x45, MOVE, B, L, "MOV", "B,L", 5, 1)                              \
+    X(0x46, MOVE, B, M, "MOV", "B,M", 7, 1)                              \
+    X(0x47, MOVE, B, A, "MOV", "B,A", 5, 1)                              \
+    X(0x48, MOVE, C, B, "MOV", "C,B", 5, 1)                              \
+    X(0x49, MOVE, C, C, "MOV", "C,C", 5, 1)                              \
+    X(0x4a, MOVE, C, D, "MOV", "C,D", 5, 1)                              \
+    X(0x4b, MOVE, C, E, "MOV", "C,E", 5, 1)                              \
+    X(0x4c, MOVE, C, H, "MOV", "C,H", 5, 1)                              \
+    X(0x4d, MOVE, C, L, "MOV", "C,L", 5, 1)                              \
+    X(0x4e, MOVE, C, M, "MOV", "C,M", 7, 1)                              \
+    X(0x4f, MOVE, C, A, "MOV", "C,A", 5, 1)                              \
+    X(0x50, MOVE, D, B, "MOV", "D,B", 5, 1)                              \
+    X(0x51, MOVE, D, C, "MOV", "D,C", 5, 1)                              \
+    X(0x52, MOVE, D, D, "MOV", "D,D", 5, 1)                              \
+    X(0x53, MOVE, D, E, "MOV", "D,E", 5, 1)                              \
+    X(0x54, MOVE, D, H, "MOV", "D,H", 5, 1)                              \
+    X(0x55, MOVE, D, L, "MOV", "D,L", 5, 1)                              \
+    X(0x56, MOVE, D, M, "MOV", "D,M", 7, 1)                              \
+    X(0x57, MOVE, D, A, "MOV", "D,A", 5, 1)                              \
+    X(0x58, MOVE, E, B, "MOV", "E,B", 5, 1)                              \
+    X(0x59, MOVE, E, C, "MOV", "E,C", 5, 1)                              \
+    X(0x5a, MOVE, E, D, "MOV", "E,D", 5, 1)                              \
+    X(0x5b, MOVE, E, E, "MOV", "E,E", 5, 1)                              \
+    X(0x5c, MOVE, E, H, "MOV", "E,H", 5, 1)                              \
+    X(0x5d, MOVE, E, L, "MOV", "E,L", 5, 1)                              \
+    X(0x5e, MOVE, E, M, "MOV", "E,M", 7, 1)                              \
+    X(0x5f, MOVE, E, A, "MOV", "E,A", 5, 1)                              \
+    X(0x60, MOVE, H, B, "MOV", "H,B", 5, 1)                              \
+    X(0x61, MOVE, H, C, "MOV", "H,C", 5, 1)                              \
+    X(0x62, MOVE, H, D, "MOV", "H,D", 5, 1)                              \
+    X(0x63, MOVE, H, E, "MOV", "H,E", 5, 1)                              \
+    X(0x64, MOVE, H, H, "MOV", "H,H", 5, 1)                              \
+    X(0x65, MOVE, H, L, "MOV", "H,L", 5, 1)                              \
+    X(0x66, MOVE, H, M, "MOV", "H,M", 7, 1)                              \
+    X(0x67, MOVE, H, A, "MOV", "H,A", 5, 1)                              \
+    X(0x68, MOVE, L, B, "MOV", "L,B", 5, 1)                              \
+    X(0x69, MOVE, L, C, "MOV", "L,C", 5, 1)                              \
+    X(0x6a, MOVE, L, D, "MOV", "L,D", 5, 1)                              \
+    X(0x6b, MOVE, L, E, "MOV", "L,E", 5, 1)                              \
+    X(0x6c, MOVE, L, H, "MOV", "L,H", 5, 1)                              \
+    X(0x6d, MOVE, L, L, "MOV", "L,L", 5, 1)                              \
+    X(0x6e, MOVE, L, M, "MOV", "L,M", 7, 1)                              \
+    X(0x6f, MOVE, L, A, "MOV", "L,A", 5, 1)                              \
+    X(0x70, MOVE, M, B, "MOV", "M,B", 7, 1)                              \
+    X(0x71, MOVE, M, C, "MOV", "M,C", 7, 1)                              \
+    X(0x72, MOVE, M, D, "MOV", "M,D", 7, 1)                              \
+    X(0x73, MOVE, M, E, "MOV", "M,E", 7, 1)                              \
+    X(0x74, MOVE, M, H, "MOV", "M,H", 7, 1)                              \
+    X(0x75, MOVE, M, L, "MOV", "M,L", 7, 1)                              \
+    X(0x76, HALT, NONE, NONE, "HLT", "", 7, 1)                           \
+    X(0x77, MOVE, M, A, "MOV", "M,A", 7, 1)                              \
+    X(0x78, MOVE, A, B, "MOV", "A,B", 5, 1)                              \
+    X(0x79, MOVE, A, C, "MOV", "A,C", 5, 1)                              \
+    X(0x7a, MOVE, A, D, "MOV", "A,D", 5, 1)                              \
+    X(0x7b, MOVE, A, E, "MOV", "A,E", 5, 1)                              \
+    X(0x7c, MOVE, A, H, "MOV", "A,H", 5, 1)                              \
+    X(0x7d, MOVE, A, L, "MOV", "A,L", 5, 1)                              \
+    X(0x7e, MOVE, A, M, "MOV", "A,M", 7, 1)                              \
+    X(0x7f, MOVE, A, A, "MOV", "A,A", 5, 1)                              \
+    X(0x80, ADD_REG, B, NONE, "ADD", "B", 4, 1)                          \
+    X(0x81, ADD_REG, C, NONE, "ADD", "C", 4, 1)                          \
+    X(0x82, ADD_REG, D, NONE, "ADD", "D", 4, 1)                          \
+    X(0x83, ADD_REG, E, NONE, "ADD", "E", 4, 1)                          \
+    X(0x84, ADD_REG, H, NONE, "ADD", "H", 4, 1)                          \
+    X(0x85, ADD_REG, L, NONE, "ADD", "L", 4, 1)                          \
+    X(0x86, ADD_REG, M, NONE, "ADD", "M", 7, 1)                          \
+    X(0x87, ADD_REG, A, NONE, "ADD", "A", 4, 1)                          \
+    X(0x88, ADD_REG_WITH_CARRY, B, NONE, "ADC", "B", 4, 1)               \
+    X(0x89, ADD_REG_WITH_CARRY, C, NONE, "ADC", "C", 4, 1)               \
+    X(0x8a, ADD_REG_WITH_CARRY, D, NONE, "ADC", "D", 4, 1)               \
+    X(0x8b, ADD_REG_WITH_CARRY, E, NONE, "ADC", "E", 4, 1)               \
+    X(0x8c, ADD_REG_WITH_CARRY, H, NONE, "ADC", "H", 4, 1)               \
+    X(0x8d, ADD_REG_WITH_CARRY, L, NONE, "ADC", "L", 4, 1)               \
+    X(0x8e, ADD_REG_WITH_CARRY, M, NONE, "ADC", "M", 7, 1)               \
+    X(0x8f, ADD_REG_WITH_CARRY, A, NONE, "ADC", "A", 4, 1)               \
+    X(0x90, SUBTRACT_REG, B, NONE, "SUB", "B", 4, 1)                     \
+    X(0x91, SUBTRACT_REG, C, NONE, "SUB", "C", 4, 1)                     \
+    X(0x92, SUBTRACT_REG, D, NONE, "SUB", "D", 4, 1)                     \
+    X(0x93, SUBTRACT_REG, E, NONE, "SUB", "E", 4, 1)                     \
+    X(0x94, SUBTRACT_REG, H, NONE, "SUB", "H", 4, 1)                     \
+    X(0x95, SUBTRACT_REG, L, NONE, "SUB", "L", 4, 1)                     \
+    X(0x96, SUBTRACT_REG, M, NONE, "SUB", "M", 7, 1)                     \
+    X(0x97, SUBTRACT_REG, A, NONE, "SUB", "A", 4, 1)                     \
+    X(0x98, SUBTRACT_REG_WITH_BORROW, B, NONE, "SBB", "B", 4, 1)         \
+    X(0x99, SUBTRACT_REG_WITH_BORROW, C, NONE, "SBB", "C", 4, 1)         \
+    X(0x9a, SUBTRACT_REG_WITH_BORROW, D, NONE, "SBB", "D", 4, 1)         \
+    X(0x9b, SUBTRACT_REG_WITH_BORROW, E, NONE, "SBB", "E", 4, 1)         \
+    X(0x9c, SUBTRACT_REG_WITH_BORROW, H, NONE, "SBB", "H", 4, 1)         \
+    X(0x9d, SUBTRACT_REG_WITH_BORROW, L, NONE, "SBB", "L", 4, 1)         \
+    X(0x9e, SUBTRACT_REG_WITH_BORROW, M, NONE, "SBB", "M", 7, 1)         \
+    X(0x9f, SUBTRACT_REG_WITH_BORROW, A, NONE, "SBB", "A", 4, 1)         \
+    X(0xa0, AND_REG, B, NONE, "ANA", "B", 4, 1)                          \
+    X(0xa1, AND_REG, C, NONE, "ANA", "C", 4, 1)                          \
+    X(0xa2, AND_REG, D, NONE, "ANA", "D", 4, 1)                          \
+    X(0xa3, AND_REG, E, NONE, "ANA", "E", 4, 1)                          \
+    X(0xa4, AND_REG, H, NONE, "ANA", "H", 4, 1)                          \
+    X(0xa5, AND_REG, L, NONE, "ANA", "L", 4, 1)                          \
+    X(0xa6, AND_REG, M, NONE, "ANA", "M", 7, 1)                          \
+    X(0xa7, AND_REG, A, NONE, "ANA", "A", 4, 1)                          \
+    X(0xa8, XOR_REG, B, NONE, "XRA", "B", 4, 1)                          \
+    X(0xa9, XOR_REG, C, NONE, "XRA", "C", 4, 1)                          \
+    X(0xaa, XOR_REG, D, NONE, "XRA", "D", 4, 1)                          \
+    X(0xab, XOR_REG, E, NONE, "XRA", "E", 4, 1)                          \
+    X(0xac, XOR_REG, H, NONE, "XRA", "H", 4, 1)                          \
+    X(0xad, XOR_REG, L, NONE, "XRA", "L", 4, 1)                          \
+    X(0xae, XOR_REG, M, NONE, "XRA", "M", 7, 1)                          \
+    X(0xaf, XOR_REG, A, NONE, "XRA", "A", 4, 1)                          \
+    X(0xb0, OR_REG, B, NONE, "ORA", "B", 4, 1)                           \
+    X(0xb1, OR_REG, C, NONE, "ORA", "C", 4, 1)                           \
+    X(0xb2, OR_REG, D, NONE, "ORA", "D", 4, 1)                           \
+    X(0xb3, OR_REG, E, NONE, "ORA", "E", 4, 1)                           \
+    X(0xb4, OR_REG, H, NONE, "ORA", "H", 4, 1)                           \
+    X(0xb5, OR_REG, L, NONE, "ORA", "L", 4, 1)                           \
+    X(0xb6, OR_REG, M, NONE, "ORA", "M", 7, 1)                           \
+    X(0xb7, OR_REG, A, NONE, "ORA", "A", 4, 1)                           \
+    X(0xb8, COMPARE_REG, B, NONE, "CMP", "B", 4, 1)                      \
+    X(0xb9, COMPARE_REG, C, NONE, "CMP", "C", 4, 1)                      \
+    X(0xba, COMPARE_REG, D, NONE, "CMP", "D", 4, 1)                      \
+    X(0xbb, COMPARE_REG, E, NONE, "CMP", "E", 4, 1)                      \
+    X(0xbc, COMPARE_REG, H, NONE, "CMP", "H", 4, 1)                      \
+    X(0xbd, COMPARE_REG, L, NONE, "CMP", "L", 4, 1)                      \
+    X(0xbe, COMPARE_REG, M, NONE, "CMP", "M", 7, 1)                      \
+    X(0xbf, COMPARE_REG, A, NONE, "CMP", "A", 4, 1)                      \
+    X(0xc0, RETURN_IF_NOT_ZERO, NONE, NONE, "RNZ", "", 5, 1)             \
+    X(0xc1, POP, BC, NONE, "POP", "B", 10, 1)                            \
+    X(0xc2, JUMP_IF_NOT_ZERO, NONE, NONE, "JNZ", "", 10, 3)              \
+    X(0xc3, JUMP, NONE, NONE, "JMP", "", 10, 3)                          \
+    X(0xc4, CALL_IF_NOT_ZERO, NONE, NONE, "CNZ", "", 11, 3)              \
+    X(0xc5, PUSH, BC, NONE, "PUSH", "B", 11, 1)                          \
+    X(0xc6, ADD_IMMEDIATE, NONE, NONE, "ADI", "", 7, 2)                  \
+    X(0xc7, RESTART_0, NONE, NONE, "RST", "0", 11, 1)                    \
+    X(0xc8, RETURN_IF_ZERO, NONE, NONE, "RZ", "", 5, 1)                  \
+    X(0xc9, RETURN, NONE, NONE, "RET", "", 10, 1)                        \
+    X(0xca, JUMP_IF_ZERO, NONE, NONE, "JZ", "", 10, 3)                   \
+    X(0xcb, JUMP, NONE, NONE, "JMP", "", 10, 3)                          \
+    X(0xcc, CALL_IF_ZERO, NONE, NONE, "CZ", "", 11, 3)                   \
+    X(0xcd, CALL, NONE, NONE, "CALL", "", 17, 3)                         \
+    X(0xce, ADD_IMMEDIATE_WITH_CARRY, NONE, NONE, "ACI", "", 7, 2)       \
+    X(0xcf, RESTART_1, NONE, NONE, "RST", "1", 11, 1)                    \
+    X(0xd0, RETURN_IF_NO_CARRY, NONE, NONE, "RNC", "", 5, 1)             \
+    X(0xd1, POP, DE, NONE, "POP", "D", 10, 1)                            \
+    X(0xd2, JUMP_IF_NO_CARRY, NONE, NONE, "JNC", "", 10, 3)              \
+    X(0xd3, OUTPUT, NONE, NONE, "OUT", "", 10, 2)                        \
+    X(0xd4, CALL_IF_NO_CARRY, NONE, NONE, "CNC", "", 11, 3)              \
+    X(0xd5, PUSH, DE, NONE, "PUSH", "D", 11, 1)                          \
+    X(0xd6, SUBTRACT_IMMEDIATE, NONE, NONE, "SUI", "", 7, 2)             \
+    X(0xd7, RESTART_2, NONE, NONE, "RST", "2", 11, 1)                    \
+    X(0xd8, RETURN_IF_CARRY, NONE, NONE, "RC", "", 5, 1)                 \
+    X(0xd9, RETURN, NONE, NONE, "RET", "", 10, 1)                        \
+    X(0xda, JUMP_IF_CARRY, NONE, NONE, "JC", "", 10, 3)                  \
+    X(0xdb, INPUT, NONE, NONE, "IN", "", 10, 2)                          \
+    X(0xdc, CALL_IF_CARRY, NONE, NONE, "CC", "", 11, 3)                  \
+    X(0xdd, CALL, NONE, NONE, "CALL", "", 17, 3)                         \
+    X(0xde, SUBTRACT_IMMEDIATE_WITH_BORROW, NONE, NONE, "SBI", "", 7, 2) \
+    X(0xdf, RESTART_3, NONE, NONE, "RST", "3", 11, 1)                    \
+    X(0xe0, RETURN_IF_PARITY_ODD, NONE, NONE, "RPO", "", 5, 1)           \
+    X(0xe1, POP, HL, NONE, "POP", "H", 10, 1)                            \
+    X(0xe2, JUMP_IF_PARITY_ODD, NONE, NONE, "JPO", "", 10, 3)            \
+    X(0xe3, EXCHANGE_STACK, NONE, NONE, "XTHL", "", 18, 1)               \
+    X(0xe4, CALL_IF_PARITY_ODD, NONE, NONE, "CPO", "", 11, 3)            \
+    X(0xe5, PUSH, HL, NONE, "PUSH", "H", 11, 1)                          \
+    X(0xe6, AND_IMMEDIATE, NONE, NONE, "ANI", "", 7, 2)                  \
+    X(0xe7, RESTART_4, NONE, NONE, "RST", "4", 11, 1)                    \
+    X(0xe8, RETURN_IF_PARITY_EVEN, NONE, NONE, "RPE", "", 5, 1)          \
+    X(0xe9, LOAD_PROGRAM_COUNTER, NONE, NONE, "PCHL", "", 5, 1)          \
+    X(0xea, JUMP_IF_PARITY_EVEN, NONE, NONE, "JPE", "", 10, 3)           \
+    X(0xeb, EXCHANGE_REGS, NONE, NONE, "XCHG", "", 4, 1)                 \
+    X(0xec, CALL_IF_PARITY_EVEN, NONE, NONE, "CPE", "", 11, 3)           \
+    X(0xed, CALL, NONE, NONE, "CALL", "", 17, 3)                         \
+    X(0xee, XOR_IMMEDIATE, NONE, NONE, "XRI", "", 7, 2)                  \
+    X(0xef, RESTART_5, NONE, NONE, "RST", "5", 11, 1)                    \
+    X(0xf0, RETURN_IF_PLUS, NONE, NONE, "RP", "", 5, 1)                  \
+    X(0xf1, POP, PSW, NONE, "POP", "PSW", 10, 1)                         \
+    X(0xf2, JUMP_IF_PLUS, NONE, NONE, "JP", "", 10, 3)                   \
+    X(0xf3, DISABLE_INTERRUPT, NONE, NONE, "DI", "", 4, 1)               \
+    X(0xf4, CALL_IF_PLUS, NONE, NONE, "CP", "", 11, 3)                   \
+    X(0xf5, PUSH, PSW, NONE, "PUSH", "PSW", 11, 1)                       \
+    X(0xf6, OR_IMMEDIATE, NONE, NONE, "ORI", "", 7, 2)                   \
+    X(0xf7, RESTART_6, NONE, NONE, "RST", "6", 11, 1)                    \
+    X(0xf8, RETURN_IF_MINUS, NONE, NONE, "RM", "", 5, 1)                 \
+    X(0xf9, LOAD_SP_FROM_HL, NONE, NONE, "SPHL", "", 5, 1)               \
+    X(0xfa, JUMP_IF_MINUS, NONE, NONE, "JM", "", 10, 3)                  \
+    X(0xfb, ENABLE_INTERRUPT, NONE, NONE, "EI", "", 4, 1)                \
+    X(0xfc, CALL_IF_MINUS, NONE, NONE, "CM", "", 11, 3)                  \
+    X(0xfd, CALL, NONE, NONE, "CALL", "", 17, 3)                         \
+    X(0xfe, COMPARE_IMMEDIATE, NONE, NONE, "CPI", "", 7, 2)              \
+    X(0xff, RESTART_7, NONE, NONE, "RST", "7", 11, 1)
+
+#endif
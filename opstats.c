@@ -0,0 +1,102 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "opstats.h"
+
+OpcodeStats opcode_stats;
+
+void reset_opcode_stats(OpcodeStats *stats) {
+    memset(stats, 0, sizeof(OpcodeStats));
+}
+
+// Adds the counts in the file at `path` to `stats`, so reading several
+// files into the same OpcodeStats merges them
+bool read_opcode_stats(OpcodeStats *stats, char *path) {
+    char line[128];
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) {
+        printf("Error opening opcode stats file %s\n", path);
+        return false;
+    }
+
+    if (fgets(line, sizeof line, fp) == NULL ||
+        strncmp(line, OPSTATS_FILE_HEADER, strlen(OPSTATS_FILE_HEADER)) != 0) {
+        printf("Error: %s is not an opcode stats file\n", path);
+        fclose(fp);
+        return false;
+    }
+
+    while (fgets(line, sizeof line, fp) != NULL) {
+        unsigned int a, b;
+        unsigned long long x, y;
+
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        if (sscanf(line, "op %x %llu", &a, &x) == 2 && a < 256) {
+            stats->opcode_counts[a] += x;
+        } else if (sscanf(line, "pair %x %x %llu", &a, &b, &x) == 3 &&
+                   a < 256 && b < 256) {
+            stats->pair_counts[a][b] += x;
+        } else if (sscanf(line, "branch %x %llu %llu", &a, &x, &y) == 3 &&
+                   a < 256) {
+            stats->branch_taken[a] += x;
+            stats->branch_not_taken[a] += y;
+        } else {
+            printf("Bad opcode stats line in %s: %s", path, line);
+            fclose(fp);
+            return false;
+        }
+    }
+
+    fclose(fp);
+    return true;
+}
+
+// Text format, zero counts are left out
+void write_opcode_stats(OpcodeStats *stats, FILE *fp) {
+    fprintf(fp, "%s\n", OPSTATS_FILE_HEADER);
+
+    for (int i = 0; i < 256; i++) {
+        if (stats->opcode_counts[i] > 0) {
+            fprintf(fp, "op %02x %llu\n", i,
+                    (unsigned long long)stats->opcode_counts[i]);
+        }
+    }
+
+    for (int i = 0; i < 256; i++) {
+        for (int j = 0; j < 256; j++) {
+            if (stats->pair_counts[i][j] > 0) {
+                fprintf(fp, "pair %02x %02x %llu\n", i, j,
+                        (unsigned long long)stats->pair_counts[i][j]);
+            }
+        }
+    }
+
+    for (int i = 0; i < 256; i++) {
+        if (stats->branch_taken[i] > 0 || stats->branch_not_taken[i] > 0) {
+            fprintf(fp, "branch %02x %llu %llu\n", i,
+                    (unsigned long long)stats->branch_taken[i],
+                    (unsigned long long)stats->branch_not_taken[i]);
+        }
+    }
+}
+
+// Dumps the counters collected by the CPU
+bool save_opcode_stats(char *path) {
+    FILE *fp = fopen(path, "w");
+
+    if (fp == NULL) {
+        printf("Error opening opcode stats file %s\n", path);
+        return false;
+    }
+
+    write_opcode_stats(&opcode_stats, fp);
+    fclose(fp);
+    return true;
+}
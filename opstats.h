@@ -0,0 +1,44 @@
+
+#ifndef OPSTATS_H
+#define OPSTATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define OPSTATS_FILE_HEADER "# i8080 opcode stats v1"
+
+// pair_counts[a][b] counts opcode b executing right after opcode a.
+// Branch counts are only kept for conditional JMP/CALL/RET opcodes.
+typedef struct OpcodeStats {
+    uint64_t opcode_counts[256];
+    uint64_t pair_counts[256][256];
+    uint64_t branch_taken[256];
+    uint64_t branch_not_taken[256];
+    uint8_t previous_opcode;
+} OpcodeStats;
+
+// Filled in by the CPU when built with CPU_OPCODE_STATS
+extern OpcodeStats opcode_stats;
+
+static inline void count_opcode(uint8_t opcode) {
+    opcode_stats.opcode_counts[opcode]++;
+    opcode_stats.pair_counts[opcode_stats.previous_opcode][opcode]++;
+    opcode_stats.previous_opcode = opcode;
+}
+
+static inline bool count_branch(uint8_t opcode, bool taken) {
+    if (taken) {
+        opcode_stats.branch_taken[opcode]++;
+    } else {
+        opcode_stats.branch_not_taken[opcode]++;
+    }
+    return taken;
+}
+
+void reset_opcode_stats(OpcodeStats *);
+bool read_opcode_stats(OpcodeStats *, char *);
+void write_opcode_stats(OpcodeStats *, FILE *);
+bool save_opcode_stats(char *);
+
+#endif
@@ -0,0 +1,104 @@
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "framebuffer.h"
+#include "perfstats.h"
+
+#define GLYPH_WIDTH 3
+#define GLYPH_HEIGHT 5
+#define OVERLAY_X 2
+#define OVERLAY_Y 2
+#define OVERLAY_LINES 7
+#define OVERLAY_COLUMNS 16
+
+#define OVERLAY_FOREGROUND 0xffffff00
+#define OVERLAY_BACKGROUND 0xff000000
+
+// 3x5 glyphs, one row per byte with the leftmost pixel in bit 2. Only
+// the characters the overlay uses are defined, others draw blank.
+static const uint8_t glyphs[128][GLYPH_HEIGHT] = {
+    ['0'] = { 7, 5, 5, 5, 7 },
+    ['1'] = { 2, 6, 2, 2, 7 },
+    ['2'] = { 7, 1, 7, 4, 7 },
+    ['3'] = { 7, 1, 7, 1, 7 },
+    ['4'] = { 5, 5, 7, 1, 1 },
+    ['5'] = { 7, 4, 7, 1, 7 },
+    ['6'] = { 7, 4, 7, 5, 7 },
+    ['7'] = { 7, 1, 1, 1, 1 },
+    ['8'] = { 7, 5, 7, 5, 7 },
+    ['9'] = { 7, 5, 7, 1, 7 },
+    ['.'] = { 0, 0, 0, 0, 2 },
+    ['A'] = { 2, 5, 7, 5, 5 },
+    ['C'] = { 7, 4, 4, 4, 7 },
+    ['D'] = { 6, 5, 5, 5, 6 },
+    ['E'] = { 7, 4, 6, 4, 7 },
+    ['H'] = { 5, 5, 7, 5, 5 },
+    ['I'] = { 7, 2, 2, 2, 7 },
+    ['K'] = { 5, 5, 6, 5, 5 },
+    ['M'] = { 5, 7, 7, 5, 5 },
+    ['O'] = { 7, 5, 5, 5, 7 },
+    ['P'] = { 7, 5, 7, 4, 4 },
+    ['R'] = { 6, 5, 6, 5, 5 },
+    ['S'] = { 7, 4, 7, 1, 7 },
+    ['U'] = { 5, 5, 5, 5, 7 },
+    ['W'] = { 5, 5, 7, 7, 5 },
+    ['Z'] = { 7, 1, 2, 4, 7 }
+};
+
+// Draws one line of text with a background cell per character, so it
+// stays readable over the game
+static void draw_text(uint32_t *pixels, int x, int y, const char *text) {
+    for (int i = 0; text[i] != '\0' && i < OVERLAY_COLUMNS; i++) {
+        const uint8_t *glyph = glyphs[text[i] & 0x7f];
+
+        for (int row = -1; row <= GLYPH_HEIGHT; row++) {
+            for (int col = -1; col <= GLYPH_WIDTH; col++) {
+                uint32_t color = OVERLAY_BACKGROUND;
+
+                if (row >= 0 && row < GLYPH_HEIGHT && col >= 0 &&
+                    col < GLYPH_WIDTH &&
+                    (glyph[row] >> (GLYPH_WIDTH - 1 - col) & 1)) {
+                    color = OVERLAY_FOREGROUND;
+                }
+                pixels[(y + row) * SCREEN_WIDTH + x + col] = color;
+            }
+        }
+        x += GLYPH_WIDTH + 1;
+    }
+}
+
+// Draws the stats into the top left corner of a SCREEN_WIDTH by
+// SCREEN_HEIGHT frame
+void draw_perf_overlay(const PerfStats *stats, uint32_t *pixels) {
+    char lines[OVERLAY_LINES][OVERLAY_COLUMNS + 1];
+
+    snprintf(lines[0], sizeof lines[0], "%.2f MHZ", stats->emulated_mhz);
+    snprintf(lines[1], sizeof lines[1], "%.2f MIPS",
+             stats->instrs_per_sec / 1e6);
+    snprintf(lines[2], sizeof lines[2], "CPU %.2f MS", stats->cpu_ms);
+    snprintf(lines[3], sizeof lines[3], "IO %.2f MS", stats->shift_sound_ms);
+    snprintf(lines[4], sizeof lines[4], "DRAW %.2f MS", stats->render_ms);
+    snprintf(lines[5], sizeof lines[5], "PRES %.2f MS", stats->present_ms);
+    snprintf(lines[6], sizeof lines[6], "SKIP %llu",
+             (unsigned long long)stats->skipped_frame_count);
+
+    for (int i = 0; i < OVERLAY_LINES; i++) {
+        draw_text(pixels, OVERLAY_X, OVERLAY_Y + i * (GLYPH_HEIGHT + 2),
+                  lines[i]);
+    }
+}
+
+// One JSON object per line, flushed straight away for whatever is
+// reading the stream
+void write_perf_stats(const PerfStats *stats, FILE *fp) {
+    fprintf(fp, "{\"emulated_mhz\": %.3f, \"instrs_per_sec\": %.0f, "
+            "\"frame_ms\": {\"cpu\": %.3f, \"shift_sound\": %.3f, "
+            "\"render\": %.3f, \"present\": %.3f}, \"frames\": %llu, "
+            "\"skipped_frames\": %llu}\n", stats->emulated_mhz,
+            stats->instrs_per_sec, stats->cpu_ms, stats->shift_sound_ms,
+            stats->render_ms, stats->present_ms,
+            (unsigned long long)stats->frame_count,
+            (unsigned long long)stats->skipped_frame_count);
+    fflush(fp);
+}
@@ -0,0 +1,24 @@
+
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Runtime performance over the last reporting interval. Host times are
+// averages per emulated frame.
+typedef struct PerfStats {
+    double emulated_mhz;
+    double instrs_per_sec;
+    double cpu_ms;
+    double shift_sound_ms;
+    double render_ms;
+    double present_ms;
+    uint64_t frame_count;
+    uint64_t skipped_frame_count;
+} PerfStats;
+
+void draw_perf_overlay(const PerfStats *, uint32_t *);
+void write_perf_stats(const PerfStats *, FILE *);
+
+#endif
@@ -0,0 +1,384 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+
+#define NODE_TABLE_SIZE (MAX_PROFILE_NODES * 2)
+#define MAX_SYMBOL_LENGTH 32
+#define HOT_PC_COUNT 32
+
+// One node per distinct call path, so the same routine called from
+// two places gets two nodes
+typedef struct ProfileNode {
+    uint16_t address;
+    int parent;
+    uint64_t calls;
+    uint64_t self_instrs;
+    uint64_t self_cycles;
+} ProfileNode;
+
+typedef struct ProfileFrame {
+    int node;
+    uint16_t return_address;
+} ProfileFrame;
+
+typedef struct ProfileSymbol {
+    uint16_t address;
+    char name[MAX_SYMBOL_LENGTH];
+} ProfileSymbol;
+
+typedef struct RoutineStats {
+    uint16_t address;
+    uint64_t calls;
+    uint64_t self_cycles;
+    uint64_t inclusive_cycles;
+} RoutineStats;
+
+static uint64_t pc_instrs[65536];
+static uint64_t pc_cycles[65536];
+
+static ProfileNode nodes[MAX_PROFILE_NODES];
+static int node_count = 0;
+
+// Maps (parent, address) to node index + 1, 0 marks an empty slot
+static int node_table[NODE_TABLE_SIZE];
+
+static ProfileFrame stack[MAX_PROFILE_DEPTH];
+static int depth = 0;
+
+static ProfileSymbol symbols[MAX_PROFILE_SYMBOLS];
+static int symbol_count = 0;
+
+// The root node stands for whatever runs from reset, i.e. the
+// routine at 0x0000
+void reset_profile() {
+    memset(pc_instrs, 0, sizeof pc_instrs);
+    memset(pc_cycles, 0, sizeof pc_cycles);
+    memset(node_table, 0, sizeof node_table);
+
+    memset(&nodes[0], 0, sizeof nodes[0]);
+    nodes[0].parent = -1;
+    node_count = 1;
+
+    stack[0].node = 0;
+    stack[0].return_address = 0;
+    depth = 0;
+}
+
+static int find_child(int parent, uint16_t address) {
+    uint32_t slot = ((uint32_t)parent * 65536 + address) * 2654435761u;
+    slot %= NODE_TABLE_SIZE;
+
+    while (node_table[slot] != 0) {
+        int index = node_table[slot] - 1;
+        if (nodes[index].parent == parent &&
+            nodes[index].address == address) {
+            return index;
+        }
+        slot = (slot + 1) % NODE_TABLE_SIZE;
+    }
+
+    // Out of nodes, charge the callee to its caller
+    if (node_count == MAX_PROFILE_NODES) {
+        return parent;
+    }
+
+    int index = node_count++;
+    memset(&nodes[index], 0, sizeof nodes[index]);
+    nodes[index].address = address;
+    nodes[index].parent = parent;
+    node_table[slot] = index + 1;
+    return index;
+}
+
+void profile_instr(uint16_t address, int cycles) {
+    pc_instrs[address]++;
+    nodes[stack[depth].node].self_instrs++;
+    profile_cycles(address, cycles);
+}
+
+// Charges cycles to the instruction at address without counting it
+// again, for the extra cycles of a taken conditional CALL or RET. The
+// CPU calls this before the branch so the caller pays for them.
+void profile_cycles(uint16_t address, int cycles) {
+    pc_cycles[address] += cycles;
+    nodes[stack[depth].node].self_cycles += cycles;
+}
+
+void profile_call(uint16_t address, uint16_t return_address) {
+    // Too deep, fold the callee into the deepest frame so no path gets
+    // longer than MAX_PROFILE_DEPTH
+    if (depth + 1 == MAX_PROFILE_DEPTH) {
+        nodes[stack[depth].node].calls++;
+        return;
+    }
+
+    int node = find_child(stack[depth].node, address);
+
+    nodes[node].calls++;
+    depth++;
+    stack[depth].node = node;
+    stack[depth].return_address = return_address;
+}
+
+// The game sometimes drops return addresses off the stack or uses RET
+// as a computed jump, so unwind to the innermost frame that expected
+// this return address and ignore returns no frame expected
+void profile_return(uint16_t address) {
+    for (int i = depth; i > 0; i--) {
+        if (stack[i].return_address == address) {
+            depth = i - 1;
+            return;
+        }
+    }
+}
+
+static int compare_symbols(const void *a, const void *b) {
+    const ProfileSymbol *x = a;
+    const ProfileSymbol *y = b;
+    return (x->address > y->address) - (x->address < y->address);
+}
+
+// Symbol files have one "<hex address> <name>" pair per line, lines
+// starting with '#' are comments
+bool load_profile_symbols(char *path) {
+    char line[128];
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL) {
+        printf("Error opening symbol file %s\n", path);
+        return false;
+    }
+
+    symbol_count = 0;
+    while (fgets(line, sizeof line, fp) != NULL) {
+        unsigned int address;
+        char name[MAX_SYMBOL_LENGTH];
+
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "%x %31s", &address, name) != 2 ||
+            address > 0xffff) {
+            printf("Bad symbol line: %s", line);
+            fclose(fp);
+            return false;
+        }
+        if (symbol_count == MAX_PROFILE_SYMBOLS) {
+            printf("Too many symbols in %s\n", path);
+            fclose(fp);
+            return false;
+        }
+
+        symbols[symbol_count].address = address;
+        strcpy(symbols[symbol_count].name, name);
+        symbol_count++;
+    }
+
+    fclose(fp);
+    qsort(symbols, symbol_count, sizeof(ProfileSymbol), compare_symbols);
+    return true;
+}
+
+// Returns the last symbol at or before address, or NULL
+static ProfileSymbol *find_symbol(uint16_t address) {
+    int low = 0;
+    int high = symbol_count - 1;
+    ProfileSymbol *found = NULL;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (symbols[mid].address <= address) {
+            found = &symbols[mid];
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return found;
+}
+
+static void format_routine(uint16_t address, char *buf) {
+    ProfileSymbol *symbol = find_symbol(address);
+
+    if (symbol != NULL && symbol->address == address) {
+        strcpy(buf, symbol->name);
+    } else {
+        sprintf(buf, "sub_%04x", address);
+    }
+}
+
+static void format_location(uint16_t address, char *buf) {
+    ProfileSymbol *symbol = find_symbol(address);
+
+    if (symbol == NULL) {
+        sprintf(buf, "%04x", address);
+    } else if (symbol->address == address) {
+        strcpy(buf, symbol->name);
+    } else {
+        sprintf(buf, "%s+0x%x", symbol->name, address - symbol->address);
+    }
+}
+
+// One line per call path, root first, weighted by self cycles
+void write_collapsed_stacks(FILE *fp) {
+    int path[MAX_PROFILE_DEPTH];
+    char name[MAX_SYMBOL_LENGTH + 16];
+
+    for (int i = 0; i < node_count; i++) {
+        int length = 0;
+
+        if (nodes[i].self_cycles == 0) {
+            continue;
+        }
+
+        for (int n = i; n != -1; n = nodes[n].parent) {
+            path[length++] = n;
+        }
+
+        for (int j = length - 1; j >= 0; j--) {
+            format_routine(nodes[path[j]].address, name);
+            fprintf(fp, "%s%s", name, j > 0 ? ";" : "");
+        }
+        fprintf(fp, " %llu\n", (unsigned long long)nodes[i].self_cycles);
+    }
+}
+
+static int compare_inclusive(const void *a, const void *b) {
+    const RoutineStats *x = a;
+    const RoutineStats *y = b;
+    return (x->inclusive_cycles < y->inclusive_cycles) -
+           (x->inclusive_cycles > y->inclusive_cycles);
+}
+
+static int compare_pc_cycles(const void *a, const void *b) {
+    uint64_t x = pc_cycles[*(const uint16_t *)a];
+    uint64_t y = pc_cycles[*(const uint16_t *)b];
+    return (x < y) - (x > y);
+}
+
+static void write_routine_summary(FILE *fp, uint64_t total_cycles) {
+    RoutineStats *routines = calloc(65536, sizeof(RoutineStats));
+    int path[MAX_PROFILE_DEPTH];
+    char name[MAX_SYMBOL_LENGTH + 16];
+
+    for (int i = 0; i < 65536; i++) {
+        routines[i].address = i;
+    }
+
+    for (int i = 0; i < node_count; i++) {
+        RoutineStats *routine = &routines[nodes[i].address];
+        int length = 0;
+
+        routine->calls += nodes[i].calls;
+        routine->self_cycles += nodes[i].self_cycles;
+
+        // Every routine on the path gets the cycles once, even when
+        // it appears more than once through recursion
+        for (int n = i; n != -1; n = nodes[n].parent) {
+            bool seen = false;
+            for (int j = 0; j < length; j++) {
+                if (nodes[path[j]].address == nodes[n].address) {
+                    seen = true;
+                    break;
+                }
+            }
+            if (!seen) {
+                routines[nodes[n].address].inclusive_cycles +=
+                    nodes[i].self_cycles;
+            }
+            path[length++] = n;
+        }
+    }
+
+    qsort(routines, 65536, sizeof(RoutineStats), compare_inclusive);
+
+    fprintf(fp, "%-32s %10s %14s %7s %14s %7s\n", "routine", "calls",
+            "self cycles", "self%", "incl cycles", "incl%");
+    for (int i = 0; i < 65536 && routines[i].inclusive_cycles > 0; i++) {
+        format_routine(routines[i].address, name);
+        fprintf(fp, "%-32s %10llu %14llu %6.2f%% %14llu %6.2f%%\n", name,
+                (unsigned long long)routines[i].calls,
+                (unsigned long long)routines[i].self_cycles,
+                100.0 * routines[i].self_cycles / total_cycles,
+                (unsigned long long)routines[i].inclusive_cycles,
+                100.0 * routines[i].inclusive_cycles / total_cycles);
+    }
+
+    free(routines);
+}
+
+static void write_hot_pcs(FILE *fp, uint64_t total_cycles) {
+    static uint16_t order[65536];
+    char name[MAX_SYMBOL_LENGTH + 16];
+
+    for (int i = 0; i < 65536; i++) {
+        order[i] = i;
+    }
+    qsort(order, 65536, sizeof(uint16_t), compare_pc_cycles);
+
+    fprintf(fp, "%-4s %-32s %12s %14s %7s\n", "pc", "location",
+            "instrs", "cycles", "cycles%");
+    for (int i = 0; i < HOT_PC_COUNT && pc_cycles[order[i]] > 0; i++) {
+        format_location(order[i], name);
+        fprintf(fp, "%04x %-32s %12llu %14llu %6.2f%%\n", order[i], name,
+                (unsigned long long)pc_instrs[order[i]],
+                (unsigned long long)pc_cycles[order[i]],
+                100.0 * pc_cycles[order[i]] / total_cycles);
+    }
+}
+
+void write_profile_summary(FILE *fp) {
+    uint64_t total_instrs = 0;
+    uint64_t total_cycles = 0;
+
+    for (int i = 0; i < 65536; i++) {
+        total_instrs += pc_instrs[i];
+        total_cycles += pc_cycles[i];
+    }
+
+    fprintf(fp, "instructions: %llu\n", (unsigned long long)total_instrs);
+    fprintf(fp, "cycles:       %llu\n", (unsigned long long)total_cycles);
+    fprintf(fp, "call paths:   %d%s\n\n", node_count,
+            node_count == MAX_PROFILE_NODES ? " (limit reached)" : "");
+
+    if (total_cycles == 0) {
+        return;
+    }
+
+    write_routine_summary(fp, total_cycles);
+    fprintf(fp, "\n");
+    write_hot_pcs(fp, total_cycles);
+}
+
+// Writes <prefix>.folded for flamegraph tools and <prefix>.txt with
+// the per-routine and per-PC summary
+bool write_profile(char *prefix) {
+    char path[4096];
+    FILE *fp;
+
+    snprintf(path, sizeof path, "%s.folded", prefix);
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        printf("Error opening profile file %s\n", path);
+        return false;
+    }
+    write_collapsed_stacks(fp);
+    fclose(fp);
+
+    snprintf(path, sizeof path, "%s.txt", prefix);
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        printf("Error opening profile file %s\n", path);
+        return false;
+    }
+    write_profile_summary(fp);
+    fclose(fp);
+
+    return true;
+}
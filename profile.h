@@ -0,0 +1,28 @@
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Limits for the call tree built from the shadow call stack. Frames
+// deeper than MAX_PROFILE_DEPTH are folded into the deepest one and
+// new call paths beyond MAX_PROFILE_NODES into their caller.
+#define MAX_PROFILE_DEPTH 64
+#define MAX_PROFILE_NODES 16384
+#define MAX_PROFILE_SYMBOLS 4096
+
+// Called by the CPU when built with CPU_PROFILE
+void profile_instr(uint16_t, int);
+void profile_cycles(uint16_t, int);
+void profile_call(uint16_t, uint16_t);
+void profile_return(uint16_t);
+
+void reset_profile(void);
+bool load_profile_symbols(char *);
+void write_collapsed_stacks(FILE *);
+void write_profile_summary(FILE *);
+bool write_profile(char *);
+
+#endif
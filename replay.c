@@ -0,0 +1,96 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "machine.h"
+#include "replay.h"
+
+// Inserts a coin, starts a one player game and then keeps moving
+// and firing so that most of the game's routines get exercised
+static InputEvent builtin_events[] = {
+    {  120, INPUT_CREDIT },
+    {  130, 0 },
+    {  180, INPUT_1P_START },
+    {  190, 0 },
+    {  300, INPUT_LEFT | INPUT_FIRE },
+    {  320, INPUT_LEFT },
+    {  400, INPUT_RIGHT | INPUT_FIRE },
+    {  420, INPUT_RIGHT },
+    {  560, INPUT_LEFT | INPUT_FIRE },
+    {  580, INPUT_LEFT },
+    {  700, INPUT_FIRE },
+    {  720, 0 },
+    {  800, INPUT_RIGHT | INPUT_FIRE },
+    {  820, INPUT_RIGHT },
+    {  900, INPUT_LEFT | INPUT_FIRE },
+    {  920, INPUT_LEFT },
+    { 1000, INPUT_FIRE },
+    { 1020, 0 }
+};
+
+void load_builtin_input_script(InputScript *script) {
+    script->events = builtin_events;
+    script->event_count = sizeof builtin_events / sizeof builtin_events[0];
+    script->next_event = 0;
+    script->inputs = 0;
+}
+
+// Scripts are text files with one "<frame> <input mask in hex>" pair
+// per line, sorted by frame. Lines starting with '#' are ignored.
+bool load_input_script(InputScript *script, char *path) {
+    FILE *fp = fopen(path, "r");
+    char line[128];
+    int capacity = 64;
+
+    if (fp == NULL) {
+        printf("Error opening input script %s\n", path);
+        return false;
+    }
+
+    script->events = malloc(capacity * sizeof(InputEvent));
+    script->event_count = 0;
+    script->next_event = 0;
+    script->inputs = 0;
+
+    while (fgets(line, sizeof line, fp) != NULL) {
+        unsigned int frame;
+        unsigned int inputs;
+
+        if (line[0] == '#' || sscanf(line, "%u %x", &frame, &inputs) != 2) {
+            continue;
+        }
+
+        if (script->event_count == capacity) {
+            capacity *= 2;
+            script->events = realloc(script->events,
+                                     capacity * sizeof(InputEvent));
+        }
+
+        script->events[script->event_count].frame = frame;
+        script->events[script->event_count].inputs = inputs;
+        script->event_count++;
+    }
+
+    fclose(fp);
+    return true;
+}
+
+void free_input_script(InputScript *script) {
+    if (script->events != builtin_events) {
+        free(script->events);
+    }
+    script->events = NULL;
+    script->event_count = 0;
+}
+
+// Frames must be requested in increasing order
+uint8_t get_script_inputs(InputScript *script, uint32_t frame) {
+    while (script->next_event < script->event_count &&
+           script->events[script->next_event].frame <= frame) {
+        script->inputs = script->events[script->next_event].inputs;
+        script->next_event++;
+    }
+    return script->inputs;
+}
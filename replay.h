@@ -0,0 +1,27 @@
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The input mask (see machine.h) changes to `inputs` on `frame`
+// and holds until the next event
+typedef struct InputEvent {
+    uint32_t frame;
+    uint8_t inputs;
+} InputEvent;
+
+typedef struct InputScript {
+    InputEvent *events;
+    int event_count;
+    int next_event;
+    uint8_t inputs;
+} InputScript;
+
+void load_builtin_input_script(InputScript *);
+bool load_input_script(InputScript *, char *);
+void free_input_script(InputScript *);
+uint8_t get_script_inputs(InputScript *, uint32_t);
+
+#endif
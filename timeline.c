@@ -0,0 +1,137 @@
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "timeline.h"
+
+typedef struct TimelineThread {
+    const char *name;
+    int id;
+    TimelineChunk *first;
+    TimelineChunk *last;
+    struct TimelineThread *next;
+} TimelineThread;
+
+atomic_bool is_timeline_recording = false;
+
+static FILE *timeline_file = NULL;
+static uint64_t timeline_start_ns = 0;
+
+// Every thread that recorded something, guarded by threads_lock. Threads
+// only take the lock the first time they record.
+static TimelineThread *threads = NULL;
+static int thread_count = 0;
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local TimelineThread *current_thread = NULL;
+
+static TimelineThread *get_current_thread(void) {
+    if (current_thread == NULL) {
+        TimelineThread *thread = calloc(1, sizeof(TimelineThread));
+        thread->first = calloc(1, sizeof(TimelineChunk));
+        thread->last = thread->first;
+
+        pthread_mutex_lock(&threads_lock);
+        thread->id = ++thread_count;
+        thread->next = threads;
+        threads = thread;
+        pthread_mutex_unlock(&threads_lock);
+
+        current_thread = thread;
+    }
+    return current_thread;
+}
+
+void record_timeline_event(const char *name, uint64_t start_ns,
+                           uint64_t duration_ns) {
+    TimelineThread *thread = get_current_thread();
+    TimelineChunk *chunk = thread->last;
+    int count = atomic_load_explicit(&chunk->count, memory_order_relaxed);
+
+    if (count == TIMELINE_CHUNK_EVENTS) {
+        TimelineChunk *next = calloc(1, sizeof(TimelineChunk));
+        atomic_store_explicit(&chunk->next, next, memory_order_release);
+        thread->last = next;
+        chunk = next;
+        count = 0;
+    }
+
+    chunk->events[count].name = name;
+    chunk->events[count].start_ns = start_ns;
+    chunk->events[count].duration_ns = duration_ns;
+    atomic_store_explicit(&chunk->count, count + 1, memory_order_release);
+}
+
+// Shows up as the thread's name in the trace viewer
+void name_timeline_thread(const char *name) {
+    if (atomic_load_explicit(&is_timeline_recording, memory_order_relaxed)) {
+        get_current_thread()->name = name;
+    }
+}
+
+// Starts recording phases of the main loop and the threads around it
+// as a Chrome trace event file, which chrome://tracing and Perfetto
+// open directly
+bool start_timeline(char *path) {
+    timeline_file = fopen(path, "w");
+    if (timeline_file == NULL) {
+        printf("Error opening timeline file %s\n", path);
+        return false;
+    }
+
+    timeline_start_ns = get_timeline_ns();
+    atomic_store(&is_timeline_recording, true);
+    return true;
+}
+
+static void write_thread(TimelineThread *thread, bool *is_first) {
+    if (thread->name != NULL) {
+        fprintf(timeline_file, "%s\n{\"name\": \"thread_name\", "
+                "\"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                "\"args\": {\"name\": \"%s\"}}", *is_first ? "" : ",",
+                thread->id, thread->name);
+        *is_first = false;
+    }
+
+    for (TimelineChunk *chunk = thread->first; chunk != NULL;
+         chunk = atomic_load_explicit(&chunk->next, memory_order_acquire)) {
+        int count = atomic_load_explicit(&chunk->count, memory_order_acquire);
+
+        for (int i = 0; i < count; i++) {
+            TimelineEvent *event = &chunk->events[i];
+            fprintf(timeline_file, "%s\n{\"name\": \"%s\", \"ph\": \"X\", "
+                    "\"pid\": 1, \"tid\": %d, \"ts\": %.3f, "
+                    "\"dur\": %.3f}", *is_first ? "" : ",", event->name,
+                    thread->id,
+                    (event->start_ns - timeline_start_ns) / 1000.0,
+                    event->duration_ns / 1000.0);
+            *is_first = false;
+        }
+    }
+}
+
+// Writes out everything recorded so far. Threads that are still running
+// may keep adding to their buffers, so those are never freed.
+void stop_timeline(void) {
+    bool is_first = true;
+
+    if (timeline_file == NULL) {
+        return;
+    }
+    atomic_store(&is_timeline_recording, false);
+
+    fprintf(timeline_file, "{\"traceEvents\": [");
+    pthread_mutex_lock(&threads_lock);
+    for (TimelineThread *thread = threads; thread != NULL;
+         thread = thread->next) {
+        write_thread(thread, &is_first);
+    }
+    pthread_mutex_unlock(&threads_lock);
+    fprintf(timeline_file, "\n], \"displayTimeUnit\": \"ms\"}\n");
+
+    fclose(timeline_file);
+    timeline_file = NULL;
+}
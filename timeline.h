@@ -0,0 +1,58 @@
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// Events each thread buffers before it allocates another chunk
+#define TIMELINE_CHUNK_EVENTS 4096
+
+typedef struct TimelineEvent {
+    const char *name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+} TimelineEvent;
+
+// Only the owning thread appends. count and next are atomic so the
+// file can be written while a thread is still recording.
+typedef struct TimelineChunk {
+    TimelineEvent events[TIMELINE_CHUNK_EVENTS];
+    _Atomic int count;
+    struct TimelineChunk *_Atomic next;
+} TimelineChunk;
+
+extern atomic_bool is_timeline_recording;
+
+static inline uint64_t get_timeline_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void record_timeline_event(const char *, uint64_t, uint64_t);
+
+// Brackets a phase: the start time is 0 when not recording, so a
+// disabled timeline costs a load and a branch at each end
+static inline uint64_t begin_timeline_event(void) {
+    if (!atomic_load_explicit(&is_timeline_recording,
+                              memory_order_relaxed)) {
+        return 0;
+    }
+    return get_timeline_ns();
+}
+
+// `name` has to outlive the recording, normally a string literal
+static inline void end_timeline_event(const char *name, uint64_t start) {
+    if (start != 0) {
+        record_timeline_event(name, start, get_timeline_ns() - start);
+    }
+}
+
+bool start_timeline(char *);
+void name_timeline_thread(const char *);
+void stop_timeline(void);
+
+#endif
@@ -0,0 +1,75 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../mixer.h"
+
+#define BYTES_PER_LINE 12
+#define SAMPLES_PER_LINE 10
+
+static void write_rom(char *path) {
+    FILE *fp = fopen(path, "rb");
+    int c;
+    uint32_t size = 0;
+
+    if (fp == NULL) {
+        fprintf(stderr, "Error opening ROM file %s\n", path);
+        exit(1);
+    }
+
+    printf("const uint8_t embedded_rom[] = {");
+    while ((c = fgetc(fp)) != EOF) {
+        printf("%s0x%02x,", size % BYTES_PER_LINE == 0 ? "\n    " : " ", c);
+        size++;
+    }
+    printf("\n};\n\n");
+    printf("const uint32_t embedded_rom_size = %u;\n\n", size);
+
+    fclose(fp);
+}
+
+static void write_sound(int type, uint32_t *length, uint32_t *rate) {
+    int16_t *pcm;
+
+    if (!decode_wav(get_sound_path(type), &pcm, length, rate)) {
+        exit(1);
+    }
+
+    printf("static const int16_t sound_%d[] = {", type);
+    for (uint32_t i = 0; i < *length; i++) {
+        printf("%s%d,", i % SAMPLES_PER_LINE == 0 ? "\n    " : " ", pcm[i]);
+    }
+    // Keeps the array non-empty
+    printf("\n    0\n};\n\n");
+
+    free(pcm);
+}
+
+// Writes a C file with the ROM and the decoded sounds for builds with
+// EMBED_ASSETS. Run from the repository root so the sound paths
+// resolve.
+int main(int argc, char *argv[]) {
+    uint32_t lengths[SOUND_COUNT];
+    uint32_t rates[SOUND_COUNT];
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s rom > assets.c\n", argv[0]);
+        exit(1);
+    }
+
+    printf("\n// Generated by tools/embed-assets, do not edit\n\n");
+    printf("#include <stdint.h>\n\n#include \"assets.h\"\n\n");
+
+    write_rom(argv[1]);
+    for (int i = 0; i < SOUND_COUNT; i++) {
+        write_sound(i, &lengths[i], &rates[i]);
+    }
+
+    printf("const EmbeddedSound embedded_sounds[SOUND_COUNT] = {\n");
+    for (int i = 0; i < SOUND_COUNT; i++) {
+        printf("    { sound_%d, %u, %u },\n", i, lengths[i], rates[i]);
+    }
+    printf("};\n");
+}
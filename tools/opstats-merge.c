@@ -0,0 +1,143 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../disasm.h"
+#include "../opstats.h"
+
+#define DEFAULT_TOP_COUNT 20
+
+typedef struct RankedPair {
+    uint8_t first;
+    uint8_t second;
+    uint64_t count;
+} RankedPair;
+
+static OpcodeStats merged;
+
+static char *get_mnemonic(uint8_t opcode, char *buf) {
+    const DisasmInfo *info = get_disasm_info(opcode);
+
+    sprintf(buf, "%02x %s %s", opcode, info->mnemonic, info->registers);
+    return buf;
+}
+
+static int compare_opcodes(const void *a, const void *b) {
+    uint64_t x = merged.opcode_counts[*(const uint8_t *)a];
+    uint64_t y = merged.opcode_counts[*(const uint8_t *)b];
+    return (x < y) - (x > y);
+}
+
+static int compare_pairs(const void *a, const void *b) {
+    uint64_t x = ((const RankedPair *)a)->count;
+    uint64_t y = ((const RankedPair *)b)->count;
+    return (x < y) - (x > y);
+}
+
+static void print_summary(int top_count) {
+    static RankedPair pairs[65536];
+    uint8_t order[256];
+    uint64_t total = 0;
+    char a[16];
+    char b[16];
+
+    for (int i = 0; i < 256; i++) {
+        order[i] = i;
+        total += merged.opcode_counts[i];
+    }
+    if (total == 0) {
+        printf("No instructions counted\n");
+        return;
+    }
+
+    qsort(order, 256, sizeof(uint8_t), compare_opcodes);
+    printf("%-12s %14s %7s\n", "opcode", "count", "share");
+    for (int i = 0; i < top_count && i < 256; i++) {
+        uint64_t count = merged.opcode_counts[order[i]];
+        if (count == 0) {
+            break;
+        }
+        printf("%-12s %14llu %6.2f%%\n", get_mnemonic(order[i], a),
+               (unsigned long long)count, 100.0 * count / total);
+    }
+
+    for (int i = 0; i < 65536; i++) {
+        pairs[i].first = i >> 8;
+        pairs[i].second = i & 0xff;
+        pairs[i].count = merged.pair_counts[i >> 8][i & 0xff];
+    }
+    qsort(pairs, 65536, sizeof(RankedPair), compare_pairs);
+    printf("\n%-12s %-12s %14s %7s\n", "first", "second", "count", "share");
+    for (int i = 0; i < top_count && pairs[i].count > 0; i++) {
+        printf("%-12s %-12s %14llu %6.2f%%\n",
+               get_mnemonic(pairs[i].first, a),
+               get_mnemonic(pairs[i].second, b),
+               (unsigned long long)pairs[i].count,
+               100.0 * pairs[i].count / total);
+    }
+
+    printf("\n%-12s %14s %14s %7s\n", "branch", "taken", "not taken",
+           "taken%");
+    for (int i = 0; i < 256; i++) {
+        uint64_t taken = merged.branch_taken[i];
+        uint64_t not_taken = merged.branch_not_taken[i];
+        if (taken + not_taken == 0) {
+            continue;
+        }
+        printf("%-12s %14llu %14llu %6.2f%%\n", get_mnemonic(i, a),
+               (unsigned long long)taken, (unsigned long long)not_taken,
+               100.0 * taken / (taken + not_taken));
+    }
+}
+
+static void print_usage(char *name) {
+    printf("Usage: %s [-o merged_file] [-n top_count] stats_file...\n",
+           name);
+}
+
+int main(int argc, char *argv[]) {
+    char *out_path = NULL;
+    int top_count = DEFAULT_TOP_COUNT;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:n:h")) != -1) {
+        switch (opt) {
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'n':
+                top_count = atoi(optarg);
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    if (optind >= argc) {
+        print_usage(argv[0]);
+        exit(1);
+    }
+
+    reset_opcode_stats(&merged);
+
+    for (int i = optind; i < argc; i++) {
+        if (!read_opcode_stats(&merged, argv[i])) {
+            exit(1);
+        }
+    }
+
+    if (out_path != NULL) {
+        FILE *fp = fopen(out_path, "w");
+        if (fp == NULL) {
+            printf("Error opening output file %s\n", out_path);
+            exit(1);
+        }
+        write_opcode_stats(&merged, fp);
+        fclose(fp);
+    }
+
+    print_summary(top_count);
+}
@@ -0,0 +1,88 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../disasm.h"
+#include "../trace.h"
+
+static void print_record(TraceRecord *record) {
+    uint8_t instr_bytes[3] = { record->opcode, record->operand_1,
+                               record->operand_2 };
+    char text[32];
+    char bytes[16];
+
+    int byte_count = disassemble(instr_bytes, text, sizeof text);
+
+    if (byte_count == 1) {
+        snprintf(bytes, sizeof bytes, "%02x", record->opcode);
+    } else if (byte_count == 2) {
+        snprintf(bytes, sizeof bytes, "%02x %02x", record->opcode,
+                 record->operand_1);
+    } else {
+        snprintf(bytes, sizeof bytes, "%02x %02x %02x", record->opcode,
+                 record->operand_1, record->operand_2);
+    }
+
+    printf("%12llu  %04x: %-8s  %-17s  A=%02x F=%c%c%c%c%c\n",
+           (unsigned long long)record->cycle, record->pc, bytes, text,
+           record->reg_A,
+           record->flags & 0x80 ? 'S' : '-',
+           record->flags & 0x40 ? 'Z' : '-',
+           record->flags & 0x10 ? 'A' : '-',
+           record->flags & 0x04 ? 'P' : '-',
+           record->flags & 0x01 ? 'C' : '-');
+}
+
+int main(int argc, char *argv[]) {
+    TraceFileHeader header;
+    TraceRecord record;
+    long tail_count = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:h")) != -1) {
+        switch (opt) {
+            case 't':
+                tail_count = atol(optarg);
+                break;
+            default:
+                printf("Usage: %s [-t last_n_records] trace_file\n", argv[0]);
+                exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    if (optind >= argc) {
+        printf("Usage: %s [-t last_n_records] trace_file\n", argv[0]);
+        exit(1);
+    }
+
+    FILE *fp = fopen(argv[optind], "rb");
+    if (fp == NULL) {
+        printf("Error opening trace file %s\n", argv[optind]);
+        exit(1);
+    }
+
+    if (fread(&header, sizeof header, 1, fp) != 1 ||
+        memcmp(header.magic, TRACE_FILE_MAGIC, sizeof header.magic) != 0 ||
+        header.version != TRACE_FILE_VERSION ||
+        header.record_size != sizeof(TraceRecord)) {
+        printf("Error: %s is not a version %d trace file\n", argv[optind],
+               TRACE_FILE_VERSION);
+        exit(1);
+    }
+
+    if (tail_count > 0) {
+        fseek(fp, 0, SEEK_END);
+        long records = (ftell(fp) - (long)sizeof header) / sizeof record;
+        long skip = records > tail_count ? records - tail_count : 0;
+        fseek(fp, sizeof header + skip * sizeof record, SEEK_SET);
+    }
+
+    while (fread(&record, sizeof record, 1, fp) == 1) {
+        print_record(&record);
+    }
+
+    fclose(fp);
+}
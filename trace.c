@@ -0,0 +1,109 @@
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpu.h"
+#include "trace.h"
+
+// How long the writer sleeps when the ring is empty
+#define WRITER_IDLE_NS 1000000
+
+static TraceRing *ring = NULL;
+static FILE *trace_file = NULL;
+static pthread_t writer_thread;
+static atomic_bool stopping = false;
+
+// Writes everything between tail and head, returns the record count
+static uint32_t drain_ring() {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t count = head - tail;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    uint32_t start = tail & (TRACE_RING_SIZE - 1);
+    uint32_t first = TRACE_RING_SIZE - start;
+    if (first > count) {
+        first = count;
+    }
+
+    fwrite(&ring->records[start], sizeof(TraceRecord), first, trace_file);
+    fwrite(&ring->records[0], sizeof(TraceRecord), count - first, trace_file);
+
+    // Flushed every time so the trace survives a crash
+    fflush(trace_file);
+
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+    return count;
+}
+
+static void *write_trace(void *arg) {
+    (void)arg;
+
+    while (!atomic_load(&stopping)) {
+        if (drain_ring() == 0) {
+            struct timespec idle = { 0, WRITER_IDLE_NS };
+            nanosleep(&idle, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+// Starts recording every executed instruction to `path`. When
+// `lossless` is set the CPU waits for the writer instead of dropping
+// records when the ring is full.
+bool start_trace(char *path, bool lossless) {
+    TraceFileHeader header;
+
+    trace_file = fopen(path, "wb");
+    if (trace_file == NULL) {
+        printf("Error opening trace file %s\n", path);
+        return false;
+    }
+
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof header.magic);
+    header.version = TRACE_FILE_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    fwrite(&header, sizeof header, 1, trace_file);
+
+    ring = calloc(1, sizeof(TraceRing));
+    ring->lossless = lossless;
+
+    atomic_store(&stopping, false);
+    pthread_create(&writer_thread, NULL, write_trace, NULL);
+
+    set_trace_ring(ring);
+    return true;
+}
+
+void stop_trace() {
+    if (ring == NULL) {
+        return;
+    }
+
+    set_trace_ring(NULL);
+
+    atomic_store(&stopping, true);
+    pthread_join(writer_thread, NULL);
+    drain_ring();
+
+    if (ring->dropped > 0) {
+        printf("Trace dropped %llu records\n",
+               (unsigned long long)ring->dropped);
+    }
+
+    fclose(trace_file);
+    free(ring);
+    ring = NULL;
+    trace_file = NULL;
+}
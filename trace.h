@@ -0,0 +1,64 @@
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Must be a power of two
+#define TRACE_RING_SIZE (1 << 16)
+
+#define TRACE_FILE_MAGIC "I8080TRC"
+#define TRACE_FILE_VERSION 1
+
+// State before the instruction executed
+typedef struct TraceRecord {
+    uint64_t cycle;
+    uint16_t pc;
+    uint8_t opcode;
+    uint8_t operand_1;
+    uint8_t operand_2;
+    uint8_t reg_A;
+    uint8_t flags;
+    uint8_t padding;
+} TraceRecord;
+
+typedef struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+} TraceFileHeader;
+
+// Single producer (the emulation thread), single consumer (the writer
+// thread) ring. head and tail only ever increase and are masked when
+// indexing.
+typedef struct TraceRing {
+    TraceRecord records[TRACE_RING_SIZE];
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    // Wait for the writer instead of dropping records when full
+    bool lossless;
+    uint64_t dropped;
+} TraceRing;
+
+static inline void push_trace_record(TraceRing *ring, TraceRecord *record) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    while (head - tail == TRACE_RING_SIZE) {
+        if (!ring->lossless) {
+            ring->dropped++;
+            return;
+        }
+        tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    }
+
+    ring->records[head & (TRACE_RING_SIZE - 1)] = *record;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+bool start_trace(char *, bool);
+void stop_trace(void);
+
+#endif